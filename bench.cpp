@@ -0,0 +1,274 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <tuple>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif // _WIN32
+
+#include "bench.hpp"
+#include "util.hpp"
+#include "output.hpp"
+
+struct bench_target_t {
+    char const * prefix;
+    char const * address;
+};
+
+// Pool prefixes of different lengths and addresses of 30 and 31 chars, each
+// thread appends its own nosohash_prefix as the miner does
+constexpr static
+bench_target_t const bench_targets[] {
+    { "",    "NbGP2VXhtkJSbEtHYz2uNfKRo34YDq" },
+    { "a7",  "N2kFAtGWLb57Qz91sexZSAnYwA3T7Cy" },
+    { "Q!z", "N3ZFCiE5qkgmXyzDU5WZ6yApp8gJhW2" },
+    { "0fX", "N4ZR3fKhSUod34evnEcDQ2M4XKxi5m" },
+};
+
+constexpr static
+char const bench_lb_hash[33] { "0000A1B2C3D4E5F60718293A4B5C6D7E" };
+
+constexpr static
+std::uint32_t const bench_round_hashes { 1 << 16 };
+
+template <typename THasher>
+void bench_hashing( THasher & hasher, std::uint32_t thread_id, std::atomic<bool> const & running,
+        std::uint64_t & hashes_count, std::uint64_t & hits_count ) {
+    std::vector<CNosoHashHit> hits;
+    for ( std::size_t round = 0; running; ++round ) {
+        bench_target_t const & target { bench_targets[round % std::size( bench_targets )] };
+        std::string prefix { target.prefix + nosohash_prefix( thread_id ) };
+        prefix.append( 9 - prefix.size(), '!' );
+        hasher.Init( prefix.c_str(), target.address );
+        for ( std::uint32_t counter = 0;
+                counter < bench_round_hashes && running.load( std::memory_order_relaxed ); ) {
+            hits.clear();
+            std::uint32_t const count { hasher.HashRange( counter, DEFAULT_HASHING_RANGE, bench_lb_hash, 4, hits ) };
+            counter += count;
+            hashes_count += count;
+            hits_count += hits.size();
+        }
+    }
+}
+
+inline
+void bench_thread( CNosoHashKernel kernel, std::uint32_t thread_id, std::int32_t cpu,
+        std::atomic<bool> const & started, std::atomic<bool> const & running,
+        std::uint64_t & hashes_count, std::uint64_t & hits_count ) {
+    if ( cpu >= 0 ) noso_pin_thread( cpu );
+    CNosoHasher hasher { kernel == CNosoHashKernel::SSE2 ? CNosoStatKernel::SSE2 : CNosoStatKernel::SCALAR };
+#ifdef NOSO_HASHING_X86
+    std::unique_ptr<CNosoHasherAVX2> hasher_avx2;
+    std::unique_ptr<CNosoHasherAVX512> hasher_avx512;
+    if ( kernel == CNosoHashKernel::AVX2 ) hasher_avx2 = std::make_unique<CNosoHasherAVX2>();
+    if ( kernel == CNosoHashKernel::AVX512 ) hasher_avx512 = std::make_unique<CNosoHasherAVX512>();
+#endif // NOSO_HASHING_X86
+    while ( !started ) std::this_thread::yield();
+    switch ( kernel ) {
+#ifdef NOSO_HASHING_X86
+    case CNosoHashKernel::AVX512: bench_hashing( *hasher_avx512, thread_id, running, hashes_count, hits_count ); break;
+    case CNosoHashKernel::AVX2: bench_hashing( *hasher_avx2, thread_id, running, hashes_count, hits_count ); break;
+#endif // NOSO_HASHING_X86
+    default: bench_hashing( hasher, thread_id, running, hashes_count, hits_count ); break;
+    }
+}
+
+// cpus are the CPUs to pin the threads to as the miner does, none to let
+// them float
+CBenchResult CBenchmark::Measure( CNosoHashKernel kernel, std::uint32_t threads, double seconds,
+        std::vector<std::uint32_t> const & cpus ) {
+    assert( kernel != CNosoHashKernel::AUTO && nosohash_kernel_supported( kernel ) && threads > 0 );
+    std::atomic<bool> started { false };
+    std::atomic<bool> running { true };
+    std::vector<std::uint64_t> hashes( threads, 0 );
+    std::vector<std::uint64_t> hits( threads, 0 );
+    std::vector<std::thread> bench_threads;
+    for ( std::uint32_t thread_id = 0; thread_id < threads; ++thread_id )
+        bench_threads.emplace_back( [&, thread_id]() {
+                bench_thread( kernel, thread_id, cpus.empty() ? -1 : std::int32_t( cpus[thread_id % cpus.size()] ),
+                        started, running, hashes[thread_id], hits[thread_id] ); } );
+    auto begin_bench { std::chrono::steady_clock::now() };
+    started = true;
+    std::this_thread::sleep_for( std::chrono::duration<double>( seconds ) );
+    running = false;
+    for ( auto & bench_thread : bench_threads ) bench_thread.join();
+    auto end_bench { std::chrono::steady_clock::now() };
+    std::chrono::duration<double> elapsed_bench { end_bench - begin_bench };
+    CBenchResult result { kernel, CNosoAffinity::NONE, threads, 0, 0, elapsed_bench.count(), 0., 0., 1., 1. };
+    for ( auto count : hashes ) result.hashes += count;
+    for ( auto count : hits ) result.hits += count;
+    result.hashrate = result.hashes / result.elapsed;
+    result.ns_per_hash = result.hashes > 0 ? 1e9 * threads / result.hashrate : 0.;
+    return result;
+}
+
+std::vector<std::uint32_t> CBenchmark::ThreadCounts( std::uint32_t max_threads ) {
+    std::vector<std::uint32_t> counts;
+    for ( std::uint32_t count = 1; count < max_threads; count *= 2 ) counts.push_back( count );
+    counts.push_back( std::max<std::uint32_t>( 1, max_threads ) );
+    return counts;
+}
+
+int CBenchmark::Run( CNosoHashKernel kernel, CNosoAffinity affinity, std::vector<std::uint32_t> const & affinity_cpus,
+        std::string const & json_filename ) {
+    std::uint32_t const max_threads { noso_usable_cpus() };
+    std::vector<CNosoHashKernel> const kernels { kernel == CNosoHashKernel::AUTO
+            ? nosohash_kernels_supported() : std::vector<CNosoHashKernel> { kernel } };
+    std::vector<std::uint32_t> const thread_counts { CBenchmark::ThreadCounts( max_threads ) };
+    CNosoAffinity const pinned { affinity == CNosoAffinity::NONE ? CNosoAffinity::AUTO : affinity };
+    std::vector<std::uint32_t> const pinned_cpus { noso_affinity_cpus( pinned, affinity_cpus ) };
+    char msg[200];
+    std::snprintf( msg, 200, "BENCHMARK noso-2m %s, %u usable CPUs, %.1f seconds per run",
+            NOSO_2M_VERSION, max_threads, DEFAULT_BENCH_SECONDS );
+    NOSO_STDOUT << msg << std::endl;
+    std::snprintf( msg, 200, " kernel | affinity | threads |  hashrate |  ns/hash | efficiency | vs none " );
+    NOSO_STDOUT << msg << std::endl;
+    std::snprintf( msg, 200, "-------------------------------------------------------------------------" );
+    NOSO_STDOUT << msg << std::endl;
+    std::vector<CBenchResult> results;
+    for ( auto bench_kernel : kernels ) {
+        std::vector<double> unpinned_hashrates;
+        for ( auto bench_affinity : { CNosoAffinity::NONE, pinned } ) {
+            double single_hashrate { 0. };
+            for ( std::size_t i = 0; i < thread_counts.size(); ++i ) {
+                std::uint32_t const threads { thread_counts[i] };
+                CBenchResult result { CBenchmark::Measure( bench_kernel, threads, DEFAULT_BENCH_SECONDS,
+                        bench_affinity == CNosoAffinity::NONE ? std::vector<std::uint32_t> {} : pinned_cpus ) };
+                result.affinity = bench_affinity;
+                if ( threads == 1 ) single_hashrate = result.hashrate;
+                result.efficiency = single_hashrate > 0. ? result.hashrate / ( threads * single_hashrate ) : 0.;
+                if ( bench_affinity == CNosoAffinity::NONE ) unpinned_hashrates.push_back( result.hashrate );
+                result.vs_none = unpinned_hashrates[i] > 0. ? result.hashrate / unpinned_hashrates[i] : 0.;
+                std::snprintf( msg, 200, " %-6s | %-8s | %7u | %7.02f%1c | %8.01f | %9.01f%% | %+6.01f%% ",
+                        nosohash_kernel_name( bench_kernel ), noso_affinity_name( bench_affinity ), threads,
+                        hashrate_pretty_value( result.hashrate ),
+                        hashrate_pretty_unit( result.hashrate ),
+                        result.ns_per_hash, 100. * result.efficiency, 100. * ( result.vs_none - 1. ) );
+                NOSO_STDOUT << msg << std::endl;
+                results.push_back( result );
+            }
+        }
+    }
+    NOSO_STDOUT << "--" << std::endl;
+    std::ofstream json_ofstream;
+    if ( json_filename != "-" ) {
+        json_ofstream.open( json_filename );
+        if ( !json_ofstream.good() ) {
+            NOSO_STDERR << "Can not write benchmark report '" << json_filename << "'" << std::endl;
+            return (-1);
+        }
+    }
+    std::ostream & json { json_filename != "-" ? json_ofstream : NOSO_STDOUT };
+    json << "{" << std::endl;
+    json << "  \"version\": \"" << NOSO_2M_VERSION << "\"," << std::endl;
+    json << "  \"usable_cpus\": " << max_threads << "," << std::endl;
+    json << "  \"seconds\": " << DEFAULT_BENCH_SECONDS << "," << std::endl;
+    json << "  \"results\": [" << std::endl;
+    char line[400];
+    for ( auto itor = std::cbegin( results ); itor != std::cend( results ); itor = std::next( itor ) ) {
+        std::snprintf( line, 400, "    { \"kernel\": \"%s\", \"affinity\": \"%s\", \"threads\": %u, \"hashes\": %llu, \"hits\": %llu, "
+                "\"elapsed\": %.6f, \"hashrate\": %.1f, \"ns_per_hash\": %.3f, \"efficiency\": %.4f, \"vs_none\": %.4f }%s",
+                nosohash_kernel_name( itor->kernel ), noso_affinity_name( itor->affinity ), itor->threads,
+                (unsigned long long)itor->hashes, (unsigned long long)itor->hits,
+                itor->elapsed, itor->hashrate, itor->ns_per_hash, itor->efficiency, itor->vs_none,
+                std::next( itor ) != std::cend( results ) ? "," : "" );
+        json << line << std::endl;
+    }
+    json << "  ]" << std::endl;
+    json << "}" << std::endl;
+    if ( json_filename != "-" )
+        NOSO_STDOUT << "Benchmark report written to '" << json_filename << "'" << std::endl;
+    return (0);
+}
+
+// What a cached calibration is valid for: the same build on the same host,
+// choosing among the same kernels with the same CPUs and pinning
+inline
+std::vector<std::tuple<std::string, std::string>> tune_signature( CNosoHashKernel kernel,
+        std::vector<std::uint32_t> const & cpus ) {
+#ifdef _WIN32
+    char const * const host_env { std::getenv( "COMPUTERNAME" ) };
+    std::string const host { host_env ? host_env : "" };
+#else
+    char host_name[256] {};
+    gethostname( host_name, sizeof( host_name ) - 1 );
+    std::string const host { host_name };
+#endif // _WIN32
+    std::string affinity;
+    for ( auto cpu : cpus ) affinity += ( affinity.empty() ? "" : "," ) + std::to_string( cpu );
+    return {
+        { "version", NOSO_2M_VERSION },
+        { "host", host },
+        { "cpus", std::to_string( noso_usable_cpus() ) },
+        { "hasher", nosohash_kernel_name( kernel ) },
+        { "affinity", affinity.empty() ? "none" : affinity },
+    };
+}
+
+CBenchResult CBenchmark::Tune( CNosoHashKernel kernel, std::vector<std::uint32_t> const & cpus ) {
+    std::vector<CNosoHashKernel> const kernels { kernel == CNosoHashKernel::AUTO
+            ? nosohash_kernels_supported() : std::vector<CNosoHashKernel> { kernel } };
+    CBenchResult best { CBenchmark::Measure( kernels.front(), 1, DEFAULT_TUNE_SECONDS, cpus ) };
+    for ( auto tune_kernel : kernels ) {
+        for ( auto threads : CBenchmark::ThreadCounts( noso_usable_cpus() ) ) {
+            if ( tune_kernel == best.kernel && threads == best.threads ) continue;
+            CBenchResult const result { CBenchmark::Measure( tune_kernel, threads, DEFAULT_TUNE_SECONDS, cpus ) };
+            if ( result.hashrate > best.hashrate ) best = result;
+        }
+    }
+    return best;
+}
+
+bool CBenchmark::LoadTune( std::string const & filename, CNosoHashKernel kernel,
+        std::vector<std::uint32_t> const & cpus, CBenchResult & result ) {
+    std::ifstream tune_ifstream( filename );
+    if ( !tune_ifstream.good() ) return false;
+    auto const signature { tune_signature( kernel, cpus ) };
+    std::size_t matches { 0 };
+    bool has_kernel { false };
+    result = CBenchResult { CNosoHashKernel::AUTO, CNosoAffinity::NONE, 0, 0, 0, 0., 0., 0., 1., 1. };
+    std::string line_str;
+    while ( std::getline( tune_ifstream, line_str ) ) {
+        std::size_t const space { line_str.find( ' ' ) };
+        if ( line_str.empty() || line_str[0] == '#' || space == std::string::npos ) continue;
+        std::string const key { line_str.substr( 0, space ) };
+        std::string const value { line_str.substr( space + 1 ) };
+        for ( auto const & [ sig_key, sig_value ] : signature ) {
+            if ( key != sig_key ) continue;
+            if ( value != sig_value ) return false;
+            ++matches;
+        }
+        try {
+            if ( key == "kernel" ) has_kernel = nosohash_kernel_from_name( value, result.kernel );
+            else if ( key == "threads" ) result.threads = std::stoul( value );
+            else if ( key == "hashrate" ) result.hashrate = std::stod( value );
+        } catch ( std::logic_error const & e ) {
+            return false;
+        }
+    }
+    return matches == signature.size() && has_kernel && result.kernel != CNosoHashKernel::AUTO
+            && nosohash_kernel_supported( result.kernel ) && result.threads > 0;
+}
+
+bool CBenchmark::SaveTune( std::string const & filename, CNosoHashKernel kernel,
+        std::vector<std::uint32_t> const & cpus, CBenchResult const & result ) {
+    std::ofstream tune_ofstream( filename );
+    if ( !tune_ofstream.good() ) return false;
+    tune_ofstream << "# noso-2m autotune result, delete this file to calibrate again" << std::endl;
+    for ( auto const & [ key, value ] : tune_signature( kernel, cpus ) )
+        tune_ofstream << key << " " << value << std::endl;
+    tune_ofstream << "kernel " << nosohash_kernel_name( result.kernel ) << std::endl;
+    tune_ofstream << "threads " << result.threads << std::endl;
+    tune_ofstream << "hashrate " << std::fixed << std::setprecision( 1 ) << result.hashrate << std::endl;
+    return tune_ofstream.good();
+}
@@ -0,0 +1,50 @@
+#ifndef __NOSO2M_BENCH_HPP__
+#define __NOSO2M_BENCH_HPP__
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <string>
+#include <vector>
+
+#include "noso-2m.hpp"
+#include "hashing.hpp"
+#include "topology.hpp"
+
+struct CBenchResult {
+    CNosoHashKernel kernel;
+    CNosoAffinity affinity;
+    std::uint32_t threads;
+    std::uint64_t hashes;
+    std::uint64_t hits;     // hashes matching the 4 leading zeros of the test target
+    double elapsed;         // seconds
+    double hashrate;        // hashes per second of all the threads
+    double ns_per_hash;     // nanoseconds a thread spends on one hash
+    double efficiency;      // hashrate over threads times the 1-thread hashrate
+    double vs_none;         // hashrate over the one of the same threads unpinned
+};
+
+// Offline hashing benchmark. Every thread hashes a fixed set of addresses and
+// prefixes, the same work for every build and machine, so the results can be
+// compared with each other. Each run is done unpinned and pinned by an
+// affinity policy, auto unless another one is given
+class CBenchmark {
+public:
+    static CBenchResult Measure( CNosoHashKernel kernel, std::uint32_t threads, double seconds,
+            std::vector<std::uint32_t> const & cpus = {} );
+    static std::vector<std::uint32_t> ThreadCounts( std::uint32_t max_threads );
+    static int Run( CNosoHashKernel kernel, CNosoAffinity affinity, std::vector<std::uint32_t> const & affinity_cpus,
+            std::string const & json_filename );
+    // Startup calibration of --autotune: the fastest of the kernels kernel
+    // allows (all the supported ones for auto) and of the threads counts up
+    // to the usable CPUs, pinned to cpus as the miner will be. The result is
+    // cached per host, kernel and cpus so that later starts skip measuring
+    static CBenchResult Tune( CNosoHashKernel kernel, std::vector<std::uint32_t> const & cpus );
+    static bool LoadTune( std::string const & filename, CNosoHashKernel kernel,
+            std::vector<std::uint32_t> const & cpus, CBenchResult & result );
+    static bool SaveTune( std::string const & filename, CNosoHashKernel kernel,
+            std::vector<std::uint32_t> const & cpus, CBenchResult const & result );
+};
+
+#endif // __NOSO2M_BENCH_HPP__
@@ -2,6 +2,7 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include <cmath>
 #include <regex>
 #include <thread>
 #include <iomanip>
@@ -141,39 +142,90 @@ CPoolStatus::CPoolStatus( const char *ps ) {
 extern char g_miner_address[];
 extern std::atomic<bool> g_still_running;
 extern std::uint32_t g_pool_shares_limit;
+extern std::uint32_t g_pool_inflight_shares;
 extern std::vector<std::tuple<std::uint32_t, double>> g_last_block_thread_hashrates;
 extern awaiting_threads_t g_all_awaiting_threads;
 
-CCommThread::CCommThread( std::uint32_t threads_count, pool_specs_t const & pool,
-        struct addrinfo const * bind_serv )
-    :   m_pool { pool }, m_bind_serv { bind_serv } {
-    for ( std::uint32_t thread_id = 0; thread_id < threads_count; ++thread_id ) {
-        auto mine_object { std::make_shared<CMineThread>( thread_id ) };
-        m_mine_objects.push_back( mine_object );
-        m_mine_threads.emplace_back( &CMineThread::Mine, mine_object, this );
+// the shares a pool takes from the miner per block, its max_shares within
+// the --shares limit
+inline
+std::uint32_t pool_max_shares( std::shared_ptr<CTarget> const & target ) {
+    auto pool_target { std::dynamic_pointer_cast<CPoolTarget>( target ) };
+    return g_pool_shares_limit > 0 ? std::min( pool_target->max_shares, g_pool_shares_limit )
+        : pool_target->max_shares;
+}
+
+CNetworkClock & network_clock() {
+    static CNetworkClock clock;
+    return clock;
+}
+
+// a response too slow bounds nothing worth it, the offset is updated with
+// every other one
+void CNetworkClock::AddSample( std::time_t utc_time,
+        std::chrono::steady_clock::time_point sent_time,
+        std::chrono::steady_clock::time_point done_time ) {
+    double const t0 { std::chrono::duration<double>( sent_time.time_since_epoch() ).count() };
+    double const t1 { std::chrono::duration<double>( done_time.time_since_epoch() ).count() };
+    if ( t1 < t0 || t1 - t0 > DEFAULT_CLOCK_MAX_RTT_SECONDS ) return;
+    double offset, uncertainty;
+    std::size_t agreeing, samples;
+    {
+        std::unique_lock<std::mutex> unique_lock_samples( m_mutex_samples );
+        m_samples.push_back( { double( utc_time ) - t1, double( utc_time ) + 1. - t0, done_time } );
+        while ( m_samples.size() > std::size_t( DEFAULT_CLOCK_SAMPLES_COUNT )
+                || done_time - m_samples.front().time > std::chrono::seconds( DEFAULT_CLOCK_SAMPLES_SECONDS ) )
+            m_samples.pop_front();
     }
+    if ( this->Estimate( offset, uncertainty, agreeing, samples ) )
+        g_network_clock_offset.store( std::llround( offset * 1e9 ), std::memory_order_relaxed );
+}
+
+bool CNetworkClock::Estimate( double & offset, double & uncertainty,
+        std::size_t & agreeing, std::size_t & samples ) const {
+    auto const now { std::chrono::steady_clock::now() };
+    // the bounds of the samples as starts (-1) and ends (+1) of ranges,
+    // starts first at a same offset so that touching ranges agree
+    std::vector<std::pair<double, int>> edges;
+    {
+        std::unique_lock<std::mutex> unique_lock_samples( m_mutex_samples );
+        samples = m_samples.size();
+        for ( auto const & sample : m_samples ) {
+            double const drift { DEFAULT_CLOCK_DRIFT_PPM * 1e-6
+                    * std::chrono::duration<double>( now - sample.time ).count() };
+            edges.push_back( { sample.lower - drift, -1 } );
+            edges.push_back( { sample.upper + drift, +1 } );
+        }
+    }
+    if ( edges.empty() ) return false;
+    std::sort( edges.begin(), edges.end() );
+    std::size_t count { 0 };
+    agreeing = 0;
+    for ( std::size_t i = 0; i + 1 < edges.size(); ++i ) {
+        count -= edges[i].second;
+        if ( count > agreeing ) {
+            agreeing = count;
+            offset = ( edges[i].first + edges[i + 1].first ) / 2.;
+            uncertainty = ( edges[i + 1].first - edges[i].first ) / 2.;
+        }
+    }
+    return true;
+}
+
+CCommThread::CCommThread( std::size_t pool_index, pool_specs_t const & pool,
+        CMineScheduler & scheduler, struct addrinfo const * bind_serv )
+    :   m_pool { pool }, m_condv_wake { std::make_shared<std::condition_variable>() },
+        m_bind_serv { bind_serv }, m_pool_index { pool_index }, m_scheduler { scheduler } {
 }
 
 inline
 void CCommThread::CloseMiningBlock( const std::chrono::duration<double>& elapsed_blck ) {
-    m_last_block_hashes_count = 0;
+    m_scheduler.DoneJob( m_mine_job );
+    m_last_block_hashes_count = m_mine_job ? m_mine_job->hashes_count.load() : 0;
     m_last_block_elapsed_secs = elapsed_blck.count();
-    g_last_block_thread_hashrates.clear();
-    for_each( m_mine_objects.begin(), m_mine_objects.end(),
-            [&]( auto const & object ) {
-                if ( object->m_exited < 2 ) {
-                    auto block_summary = object->GetBlockSummary();
-                    std::uint64_t thread_hashes { std::get<0>( block_summary ) };
-                    double thread_duration { std::get<1>( block_summary ) };
-                    double thread_hashrate { thread_hashes / thread_duration };
-                    g_last_block_thread_hashrates.push_back(
-                             std::make_tuple( object->m_thread_id, thread_hashrate ) );
-                    m_last_block_hashes_count += thread_hashes;
-                 } else if ( object->m_exited == 1 ) { // has just exited
-                     object->m_exited = 2; // exited and did summaries the last one
-                 }
-             } );
+    g_last_block_thread_hashrates = m_scheduler.GetThreadHashrates();
     m_last_block_hashrate = m_last_block_hashes_count / m_last_block_elapsed_secs;
+    m_mine_job.reset();
 }
 
 inline
@@ -182,6 +234,7 @@ void CCommThread::ResetMiningBlock() {
     m_rejected_solutions_count = 0;
     m_failured_solutions_count = 0;
     m_reached_pool_max_shares = false;
+    m_remaining_pool_shares = 0;
     this->ClearSolutions();
 };
 
@@ -229,6 +282,19 @@ void CCommThread::_ReportMiningTarget( const std::shared_ptr<CTarget>& target )
             pool_target->pool_name.substr( 0, 12 ).c_str(),
             pool_target->mn_diff.substr( 0, 32).c_str() );
     NOSO_LOG_INFO << msgbuf << std::endl;
+    double offset, uncertainty;
+    std::size_t agreeing, samples;
+    if ( network_clock().Estimate( offset, uncertainty, agreeing, samples ) ) {
+        double const skew { offset - noso_system_clock_offset() / 1e9 };
+        NOSO_LOG_DEBUG
+                << " Pool clock " << std::showpos << std::fixed << std::setprecision( 3 ) << skew
+                << std::noshowpos << " +/- " << uncertainty << " seconds off the local clock ("
+                << agreeing << " of " << samples << " samples)" << std::endl;
+        if ( std::fabs( skew ) >= DEFAULT_TIMESTAMP_DIFFERENCES ) {
+            std::snprintf( msgbuf, 100, "Local clock is %+.0f seconds off the pools, mining by the pool time", -skew );
+            NOSO_LOG_WARN << msgbuf << std::endl;
+        }
+    }
     NOSO_TUI_OutputActiWinMiningDiff( target->mn_diff.substr( 0, 32 ) );
     NOSO_TUI_OutputActiWinAcceptedSol( m_accepted_solutions_count );
     NOSO_TUI_OutputActiWinRejectedSol( m_rejected_solutions_count );
@@ -260,77 +326,188 @@ void CCommThread::_ReportTargetSummary( const std::shared_ptr<CTarget>& target )
     NOSO_TUI_OutputHistPad( msgbuf );
     NOSO_TUI_OutputHistWin();
     NOSO_TUI_OutputActiWinDefault();
+#ifdef NOSO_PROFILE
+    this->_ReportStageProfiles( target->blck_no );
+#endif // NOSO_PROFILE
 };
 
-void CCommThread::AddSolution( const std::shared_ptr<CSolution>& solution ) {
-    m_mutex_solutions.lock();
-    m_pool_solutions.push_back( solution );
-    m_mutex_solutions.unlock();
+#ifdef NOSO_PROFILE
+inline
+void CCommThread::_ReportStageProfiles( std::uint32_t blck_no ) {
+    std::vector<CNosoThreadProfile> profiles;
+    if ( !m_scheduler.TakeProfiles( blck_no, profiles ) ) return;
+    char msgbuf[100];
+    for ( std::size_t thread_id = 0; thread_id < profiles.size(); ++thread_id ) {
+        for ( std::size_t i = 0; i < NOSO_PROFILE_STAGES; ++i ) {
+            CNosoStageProfile const & stage { profiles[thread_id].stages[i] };
+            if ( stage.calls <= 0 ) continue;
+            std::snprintf( msgbuf, 100, " Profile T%03u %-7s %8.01f cycles/hash p50 %5llu p99 %5llu",
+                    std::uint32_t( thread_id ), noso_profile_stage_names[i], stage.Mean(),
+                    (unsigned long long)stage.Percentile( 0.50 ),
+                    (unsigned long long)stage.Percentile( 0.99 ) );
+            NOSO_LOG_INFO << msgbuf << std::endl;
+            std::string histogram;
+            for ( std::size_t bucket = 0; bucket < 64; ++bucket ) {
+                if ( stage.buckets[bucket] <= 0 ) continue;
+                histogram += " <2^" + std::to_string( bucket ) + ":" + std::to_string( stage.buckets[bucket] );
+            }
+            NOSO_LOG_DEBUG << " Histogram T" << thread_id << " "
+                    << noso_profile_stage_names[i] << histogram << std::endl;
+        }
+    }
+}
+#endif // NOSO_PROFILE
+
+// by the mining threads. A solution found while the ring is full is dropped,
+// the pool has got more than it can take anyway. The fences order the push
+// and the check of m_awaiting_solutions here against the store of it and the
+// check of the ring in AwaitEvent, so that either the comm thread sees the
+// solution before waiting or it gets notified
+void CCommThread::AddSolution( CSolution const & solution ) {
+    m_pool_solutions.Push( solution );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if ( m_awaiting_solutions.load( std::memory_order_relaxed ) ) {
+        std::unique_lock<std::mutex> unique_lock_wake( m_mutex_wake );
+        m_condv_wake->notify_one();
+    }
+}
+
+// the key ranking a solution, its diff to the lb_hash of the block and its
+// base, the lowest the strongest share
+inline
+std::string solution_rank( std::shared_ptr<CTarget> const & target, CSolution const & solution ) {
+    char diff[33];
+    CNosoHasher::Diff( solution.hash, target->lb_hash.c_str(), diff );
+    return std::string( diff ) + solution.base;
+}
+
+// moves the solutions the mining threads have found into the ranked ones,
+// the ones of another block, stragglers of a job just ended, and the ones of
+// a base got before are dropped
+inline
+void CCommThread::RankSolutions( std::shared_ptr<CTarget> const & target ) {
+    CSolution solution;
+    while ( m_pool_solutions.Pop( solution ) ) {
+        if ( solution.blck != target->blck_no + 1 ) continue;
+        if ( !m_solution_bases.insert( solution.base ).second ) continue;
+        m_ranked_solutions.emplace( solution_rank( target, solution ), solution );
+    }
+}
+
+// the strongest solution left of the block of target
+inline
+bool CCommThread::GetSolution( std::shared_ptr<CTarget> const & target, CSolution & solution ) {
+    this->RankSolutions( target );
+    if ( m_ranked_solutions.empty() ) return false;
+    solution = m_ranked_solutions.begin()->second;
+    m_ranked_solutions.erase( m_ranked_solutions.begin() );
+    return true;
+}
+
+// a solution which has failed to reach the pool goes back in its rank
+inline
+void CCommThread::RetrySolution( std::shared_ptr<CTarget> const & target, CSolution const & solution ) {
+    m_ranked_solutions.emplace( solution_rank( target, solution ), solution );
 }
 
 inline
 void CCommThread::ClearSolutions() {
-    m_mutex_solutions.lock();
-    m_pool_solutions.clear();
-    m_mutex_solutions.unlock();
+    m_pool_solutions.Clear();
+    m_ranked_solutions.clear();
+    m_solution_bases.clear();
 }
 
 inline
-std::size_t CCommThread::SolutionsCount() {
-    std::size_t size { 0 };
-    m_mutex_solutions.lock();
-    size = m_pool_solutions.size();
-    m_mutex_solutions.unlock();
-    return size;
+bool CCommThread::HasSolutions() const {
+    return !m_ranked_solutions.empty() || !m_pool_solutions.Empty();
 }
 
+// Waits until the time given, the end of the mining period or the stop of
+// the miner, whichever comes first, or a request done, a SOURCE one of the
+// pre-arm when sources is true, or a solution when solutions is true.
+// The wait is cut to a second as a stop notified just before waiting is lost
 inline
-const std::shared_ptr<CSolution> CCommThread::GetSolution() {
-    std::shared_ptr<CSolution> good_solution { nullptr };
-    m_mutex_solutions.lock();
-    if ( m_pool_solutions.begin() != m_pool_solutions.end() ) {
-        good_solution = m_pool_solutions.back();
-        m_pool_solutions.pop_back();
+void CCommThread::AwaitEvent( std::chrono::steady_clock::time_point until, bool solutions, bool sources ) {
+    until = std::min( { until, noso_mining_period_deadline(),
+            std::chrono::steady_clock::now() + std::chrono::seconds( 1 ) } );
+    std::unique_lock<std::mutex> unique_lock_wake( m_mutex_wake );
+    auto result = awaiting_threads_handle( m_condv_wake,
+            std::this_thread::get_id(), g_all_awaiting_threads );
+    assert( result );
+    m_awaiting_solutions.store( solutions, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    m_condv_wake->wait_until( unique_lock_wake, until, [&]() {
+            return !g_still_running
+                || ( sources ? m_finished_sources : m_finished_requests ) > 0
+                || ( solutions && this->HasSolutions() ); } );
+    m_awaiting_solutions.store( false, std::memory_order_relaxed );
+    if ( result ) {
+        awaiting_threads_release(
+                std::this_thread::get_id(), g_all_awaiting_threads );
     }
-    m_mutex_solutions.unlock();
-    return good_solution;
+}
+
+// by the reactor once a request is done, just before its result is ready,
+// and by the comm thread once it has taken the result
+inline
+void CCommThread::RequestDone( std::uint32_t & finished ) {
+    std::unique_lock<std::mutex> unique_lock_wake( m_mutex_wake );
+    ++finished;
+    m_condv_wake->notify_one();
+}
+
+inline
+void CCommThread::RequestTaken( std::uint32_t & finished ) {
+    std::unique_lock<std::mutex> unique_lock_wake( m_mutex_wake );
+    --finished;
 }
 
 bool CCommThread::IsBandedByPool() {
-    return m_been_banded_by_pool;
+    return m_been_banded_by_pool.load( std::memory_order_relaxed );
 }
 
 bool CCommThread::ReachedMaxShares() {
-    return m_reached_pool_max_shares
-            || !(   ( g_pool_shares_limit <= 0
-                            && m_accepted_solutions_count <= m_pool_max_shares )
-                    || ( g_pool_shares_limit > 0
-                            && m_accepted_solutions_count < g_pool_shares_limit )
-                );
+    return m_reached_pool_max_shares.load( std::memory_order_relaxed );
+}
+
+std::uint32_t CCommThread::RemainingShares() {
+    return m_remaining_pool_shares.load( std::memory_order_relaxed );
 }
 
 inline
 std::shared_ptr<CPoolTarget> CCommThread::RequestPoolTarget( const char address[32] ) {
     assert( std::strlen( address ) == 30 || std::strlen( address ) == 31 );
-    char msgbuf[100];
     CPoolInet inet {
             std::get<0>( m_pool ),
             std::get<1>( m_pool ),
             std::get<2>( m_pool ),
             DEFAULT_POOL_INET_TIMEOSEC,
             m_bind_serv };
+    auto const sent_time { std::chrono::steady_clock::now() };
     int rsize { inet.RequestSource( address, 
             DEFAULT_INET_COMMAND_SIZE, m_inet_command,
             DEFAULT_INET_BUFFER_SIZE, m_inet_buffer ) };
+    auto const done_time { std::chrono::steady_clock::now() };
+    auto pool_target { this->ParsePoolTarget( address, rsize, m_inet_command, m_inet_buffer ) };
+    if ( pool_target != nullptr )
+        network_clock().AddSample( pool_target->utc_time, sent_time, done_time );
+    return pool_target;
+}
+
+// the target of the response to a SOURCE request, nullptr when none
+inline
+std::shared_ptr<CPoolTarget> CCommThread::ParsePoolTarget( const char address[32], int rsize,
+        char * inet_command, char * inet_buffer ) {
+    char msgbuf[100];
     if ( rsize <= 0 ) {
         std::snprintf( msgbuf, 100,
                 "Poor connection with pool %s(%s:%s)",
-                inet.m_name.c_str(), inet.m_host.c_str(), inet.m_port.c_str() );
+                std::get<0>( m_pool ).c_str(), std::get<1>( m_pool ).c_str(), std::get<2>( m_pool ).c_str() );
         NOSO_LOG_DEBUG << msgbuf << std::endl;
         NOSO_TUI_OutputStatPad( msgbuf );
     } else {
         try {
-            CPoolStatus ps( m_inet_buffer );
+            CPoolStatus ps( inet_buffer );
             return std::make_shared<CPoolTarget>(
                 ps.blck_no,
                 ps.lb_hash,
@@ -354,31 +531,31 @@ std::shared_ptr<CPoolTarget> CCommThread::RequestPoolTarget( const char address[
         }
         catch ( const std::exception & e ) {
             if ( rsize >= 13
-                    && std::strncmp( m_inet_buffer, "WRONG_ADDRESS", 13 ) == 0 ) {
+                    && std::strncmp( inet_buffer, "WRONG_ADDRESS", 13 ) == 0 ) {
                 std::snprintf( msgbuf, 100,
                         "Submit by a wrong address %s", address );
             } else {
                 std::snprintf( msgbuf, 100,
                         "Unrecognised response from pool %s(%s:%s)",
-                        inet.m_name.c_str(), inet.m_host.c_str(), inet.m_port.c_str() );
+                        std::get<0>( m_pool ).c_str(), std::get<1>( m_pool ).c_str(), std::get<2>( m_pool ).c_str() );
                 if ( rsize > 2
-                        && m_inet_buffer[rsize - 1] == 10
-                        && m_inet_buffer[rsize - 2] == 13 ) {
-                    m_inet_buffer[rsize - 2 ] = '\0';
+                        && inet_buffer[rsize - 1] == 10
+                        && inet_buffer[rsize - 2] == 13 ) {
+                    inet_buffer[rsize - 2 ] = '\0';
                     rsize -= 2;
                 }
-                std::size_t csize = std::strlen( m_inet_command );
+                std::size_t csize = std::strlen( inet_command );
                 if ( csize > 2
-                        && m_inet_command[csize - 1] == 10
-                        && m_inet_command[csize - 2] == 13 ) {
-                    m_inet_command[rsize - 2 ] = '\0';
+                        && inet_command[csize - 1] == 10
+                        && inet_command[csize - 2] == 13 ) {
+                    inet_command[csize - 2 ] = '\0';
                     csize -= 2;
                 }
                 NOSO_LOG_DEBUG
-                        << "-->Command[" << m_inet_command << "](size=" << csize << ")"
+                        << "-->Command[" << inet_command << "](size=" << csize << ")"
                         << std::endl;
                 NOSO_LOG_DEBUG
-                        << "<--Response[" << m_inet_buffer << "](size=" << rsize << ")" << e.what()
+                        << "<--Response[" << inet_buffer << "](size=" << rsize << ")" << e.what()
                         << std::endl;
             }
             NOSO_LOG_ERROR << msgbuf << std::endl;
@@ -415,6 +592,87 @@ std::shared_ptr<CPoolTarget> CCommThread::GetPoolTargetRetrying() {
     return pool_target;
 }
 
+// connects to the pool at once and sends SOURCE at send_time
+inline
+void CCommThread::StartSourceRequest( std::chrono::steady_clock::time_point send_time ) {
+    CPoolInet inet {
+            std::get<0>( m_pool ),
+            std::get<1>( m_pool ),
+            std::get<2>( m_pool ),
+            DEFAULT_POOL_INET_TIMEOSEC,
+            m_bind_serv };
+    auto request { std::make_unique<CSourceRequest>() };
+    // SOURCE is sent no earlier than send_time, the time the request is done
+    // at is taken on the reactor thread, before the result is ready
+    request->sent_time = std::max( send_time, std::chrono::steady_clock::now() );
+    request->result = inet.StartRequestSource( g_miner_address,
+            DEFAULT_INET_COMMAND_SIZE, request->inet_command,
+            DEFAULT_INET_BUFFER_SIZE, request->inet_buffer,
+            [this, request = request.get()]() {
+                request->done_time = std::chrono::steady_clock::now();
+                this->RequestDone( m_finished_sources );
+            }, send_time );
+    m_source_requests.push_back( std::move( request ) );
+}
+
+// waits for the requests of the last pre-arm still in flight and drops them
+inline
+void CCommThread::SettleSourceRequests() {
+    for ( auto & request : m_source_requests ) {
+        if ( !request->result.valid() ) continue;
+        request->result.get();
+        this->RequestTaken( m_finished_sources );
+    }
+    m_source_requests.clear();
+}
+
+// The pre-arm of the mining period opening at opening: the pool resolved
+// and connected to beforehand, SOURCE sent the moment the period opens, then
+// repeated every DEFAULT_POOL_HEDGE_SECONDS over new connections until one
+// brings the target of the new block, up to DEFAULT_POOL_HEDGES_COUNT
+// requests. nullptr when none has, GetTarget goes on then
+inline
+std::shared_ptr<CTarget> CCommThread::GetTargetPrearmed( const char prev_lb_hash[32],
+        std::chrono::steady_clock::time_point opening ) {
+    assert( std::strlen( prev_lb_hash ) == 32 );
+    auto const hedge_interval { std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>( DEFAULT_POOL_HEDGE_SECONDS ) ) };
+    this->SettleSourceRequests();
+    this->StartSourceRequest( opening );
+    std::uint32_t started_count { 1 };
+    auto hedge_time { opening + hedge_interval };
+    while ( g_still_running ) {
+        bool in_flight { false };
+        for ( auto & request : m_source_requests ) {
+            if ( !request->result.valid() ) continue;
+            if ( request->result.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready ) {
+                in_flight = true;
+                continue;
+            }
+            int const rsize { request->result.get() };
+            this->RequestTaken( m_finished_sources );
+            auto pool_target { this->ParsePoolTarget( g_miner_address, rsize,
+                    request->inet_command, request->inet_buffer ) };
+            if ( pool_target == nullptr ) continue;
+            network_clock().AddSample( pool_target->utc_time, request->sent_time, request->done_time );
+            if ( pool_target->lb_hash != prev_lb_hash ) return pool_target;
+        }
+        if ( started_count < std::uint32_t( DEFAULT_POOL_HEDGES_COUNT ) ) {
+            if ( std::chrono::steady_clock::now() >= hedge_time ) {
+                this->StartSourceRequest( hedge_time );
+                ++started_count;
+                hedge_time += hedge_interval;
+                continue;
+            }
+        } else if ( !in_flight ) {
+            break;
+        }
+        this->AwaitEvent( started_count < std::uint32_t( DEFAULT_POOL_HEDGES_COUNT )
+                ? hedge_time : std::chrono::steady_clock::time_point::max(), false, true );
+    }
+    return nullptr;
+}
+
 inline
 std::shared_ptr<CTarget> CCommThread::GetTarget( const char prev_lb_hash[32] ) {
     assert( std::strlen( prev_lb_hash ) == 32 );
@@ -430,120 +688,192 @@ std::shared_ptr<CTarget> CCommThread::GetTarget( const char prev_lb_hash[32] ) {
     return target;
 }
 
+// the reactor sends the request and receives its response meanwhile, the
+// comm thread is woken up once it is done
 inline
-int CCommThread::SubmitPoolSolution( std::uint32_t blck_no, const char base[19], const char address[32] ) {
-    assert( std::strlen( base ) == 18
-            && ( std::strlen( address ) == 30 || std::strlen( address ) == 31 ) );
-    int ret_code { -1 };
-    char msgbuf[100];
+void CCommThread::StartSubmission( CShareSubmission & submission ) {
     CPoolInet inet {
             std::get<0>( m_pool ),
             std::get<1>( m_pool ),
             std::get<2>( m_pool ),
             DEFAULT_POOL_INET_TIMEOSEC,
             m_bind_serv };
-    for (   std::uint32_t tries_count { 0 };
-            g_still_running
-                && NOSO_BLOCK_AGE_INNER_MINING_PERIOD
-                && tries_count < std::uint32_t( DEFAULT_POOL_RETRIES_COUNT );
-            ++tries_count ) {
-        int rsize { inet.SubmitSolution( blck_no, base, address,
-                DEFAULT_INET_COMMAND_SIZE, m_inet_command,
-                DEFAULT_INET_BUFFER_SIZE, m_inet_buffer ) };
-        if ( rsize <= 0 ) {
-            std::snprintf( msgbuf, 100,
-                    "Poor connection with pool %s(%s:%s)",
-                    inet.m_name.c_str(), inet.m_host.c_str(), inet.m_port.c_str() );
-            NOSO_LOG_DEBUG << msgbuf << std::endl;
-            NOSO_TUI_OutputStatPad( msgbuf );
-            std::snprintf( msgbuf, 100,
-                    "Retry (%d/%d) submitting to pool %s...",
-                    tries_count + 1, DEFAULT_POOL_RETRIES_COUNT,
-                    std::get<0>( m_pool ).c_str() );
-            NOSO_LOG_WARN << msgbuf << std::endl;
-            NOSO_TUI_OutputStatPad( msgbuf );
-        } else {
-            // try {
-            // m_inet_buffer ~ len=(4+2)~[True\r\n] OR len=(7+2)~[False Code#(1-2)\r\n]
-            if (        rsize >= 6
-                            && std::strncmp( m_inet_buffer, "True", 4 ) == 0 ) {
-                ret_code = 0;
-                break;
-            }
-            else if (   rsize >= 9
-                            && std::strncmp( m_inet_buffer, "False ", 6 ) == 0 ) {
-                if ( rsize >= 18
-                        && std::strncmp( m_inet_buffer + 6, "SHARES_LIMIT", 12 ) == 0 ) {
-                    ret_code =  9;
-                    break;
-                }
-                std::uint32_t err_code = std::stoul( m_inet_buffer + 6 );
-                assert( err_code == 1
-                        || err_code == 2
-                        || err_code == 3
-                        || err_code == 4
-                        || err_code == 5
-                        || err_code == 7
-                        || err_code == 11
-                        || err_code == 12 );
-                if ( err_code == 1
-                        || err_code == 2
-                        || err_code == 3
-                        || err_code == 4
-                        || err_code == 5
-                        || err_code == 7
-                        || err_code == 11
-                        || err_code == 12 ) {
-                    ret_code = err_code;
-                    break;
-                }
-            }
-            // } catch ( const std::exception &e ) {}
-            std::snprintf( msgbuf, 100,
-                    "Unrecognised response from pool %s(%s:%s)",
-                    inet.m_name.c_str(), inet.m_host.c_str(), inet.m_port.c_str() );
-            if ( rsize > 2
-                    && m_inet_buffer[rsize - 1 ] == 10
-                    && m_inet_buffer[rsize - 2 ] == 13 ) {
-                m_inet_buffer[rsize - 2 ] = '\0';
-                rsize -= 2;
-            }
-            std::size_t csize = std::strlen( m_inet_command );
-            if ( csize > 2
-                    && m_inet_command[csize - 1] == 10
-                    && m_inet_command[csize - 2] == 13 ) {
-                m_inet_command[rsize - 2 ] = '\0';
-                csize -= 2;
+    submission.result = inet.StartSubmitSolution(
+            submission.solution.blck, submission.solution.base, g_miner_address,
+            DEFAULT_INET_COMMAND_SIZE, submission.inet_command,
+            DEFAULT_INET_BUFFER_SIZE, submission.inet_buffer,
+            [this]() { this->RequestDone( m_finished_requests ); } );
+}
+
+// The code of the response to a SHARE request: 0 accepted, the error code
+// of the pool when rejected, -1 when the request has not reached the pool or
+// its response is not recognised
+inline
+int CCommThread::ParseSubmission( CShareSubmission & submission, int rsize ) {
+    char msgbuf[100];
+    if ( rsize <= 0 ) {
+        std::snprintf( msgbuf, 100,
+                "Poor connection with pool %s(%s:%s)",
+                std::get<0>( m_pool ).c_str(), std::get<1>( m_pool ).c_str(), std::get<2>( m_pool ).c_str() );
+        NOSO_LOG_DEBUG << msgbuf << std::endl;
+        NOSO_TUI_OutputStatPad( msgbuf );
+        return -1;
+    }
+    char * const inet_buffer { submission.inet_buffer };
+    char * const inet_command { submission.inet_command };
+    // inet_buffer ~ len=(4+2)~[True\r\n] OR len=(7+2)~[False Code#(1-2)\r\n]
+    if (        rsize >= 6
+                    && std::strncmp( inet_buffer, "True", 4 ) == 0 ) {
+        return 0;
+    }
+    else if (   rsize >= 9
+                    && std::strncmp( inet_buffer, "False ", 6 ) == 0 ) {
+        if ( rsize >= 18
+                && std::strncmp( inet_buffer + 6, "SHARES_LIMIT", 12 ) == 0 ) {
+            return 9;
+        }
+        std::uint32_t err_code = std::stoul( inet_buffer + 6 );
+        assert( err_code == 1
+                || err_code == 2
+                || err_code == 3
+                || err_code == 4
+                || err_code == 5
+                || err_code == 7
+                || err_code == 11
+                || err_code == 12 );
+        if ( err_code == 1
+                || err_code == 2
+                || err_code == 3
+                || err_code == 4
+                || err_code == 5
+                || err_code == 7
+                || err_code == 11
+                || err_code == 12 ) {
+            return err_code;
+        }
+    }
+    std::snprintf( msgbuf, 100,
+            "Unrecognised response from pool %s(%s:%s)",
+            std::get<0>( m_pool ).c_str(), std::get<1>( m_pool ).c_str(), std::get<2>( m_pool ).c_str() );
+    if ( rsize > 2
+            && inet_buffer[rsize - 1 ] == 10
+            && inet_buffer[rsize - 2 ] == 13 ) {
+        inet_buffer[rsize - 2 ] = '\0';
+        rsize -= 2;
+    }
+    std::size_t csize = std::strlen( inet_command );
+    if ( csize > 2
+            && inet_command[csize - 1] == 10
+            && inet_command[csize - 2] == 13 ) {
+        inet_command[csize - 2 ] = '\0';
+        csize -= 2;
+    }
+    NOSO_LOG_DEBUG
+            << "-->Command[" << inet_command << "](size=" << csize << ")"
+            << std::endl;
+    NOSO_LOG_DEBUG
+            << "<--Response[" << inet_buffer << "](size=" << rsize << ")"
+            << std::endl;
+    NOSO_LOG_ERROR << msgbuf << std::endl;
+    NOSO_TUI_OutputHistPad( msgbuf );
+    NOSO_TUI_OutputStatPad( msgbuf );
+    NOSO_TUI_OutputHistWin();
+    NOSO_TUI_OutputStatWin();
+    return -1;
+}
+
+// Whether another SHARE request may be started: up to g_pool_inflight_shares
+// of them at once, no more than the shares the pool still takes
+inline
+bool CCommThread::CanSubmitSolution( std::shared_ptr<CTarget> const & target ) const {
+    std::uint32_t const max_shares { pool_max_shares( target ) };
+    return !m_been_banded_by_pool.load( std::memory_order_relaxed )
+        && !m_reached_pool_max_shares.load( std::memory_order_relaxed )
+        && m_submissions.size() < std::max( 1u, g_pool_inflight_shares )
+        && m_accepted_solutions_count + m_submissions.size() < max_shares;
+}
+
+// starts the requests of the strongest solutions while more may be in flight
+inline
+void CCommThread::SubmitSolutions( std::shared_ptr<CTarget> const & target ) {
+    CSolution solution;
+    while ( this->CanSubmitSolution( target ) && this->GetSolution( target, solution ) ) {
+        auto submission { std::make_unique<CShareSubmission>() };
+        submission->solution = solution;
+        this->StartSubmission( *submission );
+        m_submissions.push_back( std::move( submission ) );
+    }
+}
+
+// Takes the results of the requests as they arrive. A request which has not
+// reached the pool is retried up to DEFAULT_POOL_RETRIES_COUNT times, backing
+// off DEFAULT_INET_CIRCLE_SECONDS doubled at each retry, unless finishing:
+// then the ones in flight are waited for and the others fail
+inline
+void CCommThread::ReconcileSubmissions( std::shared_ptr<CTarget> const & target, bool finishing ) {
+    char msgbuf[100];
+    auto const now { std::chrono::steady_clock::now() };
+    for ( std::size_t i = 0; i < m_submissions.size(); ) {
+        CShareSubmission & submission { *m_submissions[i] };
+        if ( submission.result.valid()
+                && ( finishing || submission.result.wait_for( std::chrono::seconds( 0 ) )
+                        == std::future_status::ready ) ) {
+            int const rsize { submission.result.get() };
+            this->RequestTaken( m_finished_requests );
+            int const code { this->ParseSubmission( submission, rsize ) };
+            ++submission.tries_count;
+            if ( code < 0 && !finishing
+                    && g_still_running
+                    && NOSO_BLOCK_AGE_INNER_MINING_PERIOD
+                    && submission.tries_count < std::uint32_t( DEFAULT_POOL_RETRIES_COUNT ) ) {
+                std::snprintf( msgbuf, 100,
+                        "Retry (%d/%d) submitting to pool %s...",
+                        submission.tries_count, DEFAULT_POOL_RETRIES_COUNT,
+                        std::get<0>( m_pool ).c_str() );
+                NOSO_LOG_WARN << msgbuf << std::endl;
+                NOSO_TUI_OutputStatPad( msgbuf );
+                NOSO_TUI_OutputStatWin();
+                submission.retry_time = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>( DEFAULT_INET_CIRCLE_SECONDS * ( 1 << ( submission.tries_count - 1 ) ) ) );
+                ++i;
+                continue;
             }
-            NOSO_LOG_DEBUG
-                    << "-->Command[" << m_inet_command << "](size=" << csize << ")"
-                    << std::endl;
-            NOSO_LOG_DEBUG
-                    << "<--Response[" << m_inet_buffer << "](size=" << rsize << ")"
-                    << std::endl;
-            NOSO_LOG_ERROR << msgbuf << std::endl;
-            NOSO_TUI_OutputHistPad( msgbuf );
-            NOSO_TUI_OutputStatPad( msgbuf );
+            this->SubmitSolution( submission.solution, code, target );
+        } else if ( !submission.result.valid() && finishing ) {
+            this->SubmitSolution( submission.solution, -1, target );
+        } else {
+            if ( !submission.result.valid() && submission.retry_time <= now )
+                this->StartSubmission( submission );
+            ++i;
+            continue;
         }
-        NOSO_TUI_OutputHistWin();
-        NOSO_TUI_OutputStatWin();
-        std::this_thread::sleep_for( std::chrono::milliseconds(
-                static_cast<int>( 1'000 * DEFAULT_INET_CIRCLE_SECONDS ) ) );
+        m_submissions.erase( m_submissions.begin() + i );
     }
-    return ret_code;
 }
 
+// the time the first request waiting for its retry is due
 inline
-void CCommThread::SubmitSolution( std::shared_ptr<CSolution> const & solution,
+std::chrono::steady_clock::time_point CCommThread::NextRetryTime() const {
+    auto retry_time { std::chrono::steady_clock::time_point::max() };
+    for ( auto const & submission : m_submissions )
+        if ( !submission->result.valid() ) retry_time = std::min( retry_time, submission->retry_time );
+    return retry_time;
+}
+
+inline
+void CCommThread::SubmitSolution( CSolution const & solution, int code,
             std::shared_ptr<CTarget> const & target ) {
-    int code = this->SubmitPoolSolution( solution->blck,
-            solution->base.c_str(), g_miner_address );
     char msgbuf[100];
     auto  pool_target { std::dynamic_pointer_cast<CPoolTarget>( target ) };
     if ( code == 0 ) {
         m_accepted_solutions_count ++;
-        if ( m_accepted_solutions_count >= pool_target->max_shares )
+        std::uint32_t const max_shares { pool_max_shares( target ) };
+        if ( m_accepted_solutions_count >= max_shares ) {
+            m_remaining_pool_shares = 0;
             m_reached_pool_max_shares = true;
+        } else {
+            m_remaining_pool_shares = max_shares - m_accepted_solutions_count;
+        }
         std::snprintf( msgbuf, 100,
                 "Pool %s has accepted the %u%s of %u max shares",
                 std::get<0>( m_pool ).c_str(),
@@ -560,8 +890,8 @@ void CCommThread::SubmitSolution( std::shared_ptr<CSolution> const & solution,
         //     << m_accepted_solutions_count
         //     << "/"
         //     << pool_target->max_shares
-        //     << ")base[" << solution->base
-        //     << "]hash[" << solution->hash
+        //     << ")base[" << solution.base
+        //     << "]hash[" << solution.hash
         //     << "]"
         //     << std::endl;
         NOSO_TUI_OutputActiWinAcceptedSol( m_accepted_solutions_count );
@@ -595,13 +925,13 @@ void CCommThread::SubmitSolution( std::shared_ptr<CSolution> const & solution,
             << "]REJECTED("
             << std::setfill( '0' ) << std::setw( 2 )
             << m_rejected_solutions_count
-            << ")base[" << solution->base
-            << "]hash[" << solution->hash
+            << ")base[" << solution.base
+            << "]hash[" << solution.hash
             << "]"
             << std::endl;
         NOSO_TUI_OutputActiWinRejectedSol( m_rejected_solutions_count );
     } else { /* code < 0 */
-        this->AddSolution( solution );
+        this->RetrySolution( target, solution );
         m_failured_solutions_count ++;
         std::snprintf( msgbuf, 100, "Pool %s has failed to summit %u share(s)",
                 std::get<0>( m_pool ).c_str(), m_failured_solutions_count );
@@ -610,8 +940,8 @@ void CCommThread::SubmitSolution( std::shared_ptr<CSolution> const & solution,
             << " Pool[" << lpad( std::get<0>( m_pool ), 12, ' ' ).substr( 0, 12 )
             << "]FAILURED("
             << std::setfill( '0' ) << std::setw( 2 ) << m_failured_solutions_count
-            << ")base[" << solution->base
-            << "]hash[" << solution->hash
+            << ")base[" << solution.base
+            << "]hash[" << solution.hash
             << "]"
             << std::endl;
         NOSO_TUI_OutputActiWinFailuredSol( m_failured_solutions_count );
@@ -619,6 +949,7 @@ void CCommThread::SubmitSolution( std::shared_ptr<CSolution> const & solution,
     NOSO_TUI_OutputStatPad( msgbuf );
     NOSO_TUI_OutputStatWin();
     if ( code == 9 ) {
+        m_remaining_pool_shares = 0;
         m_reached_pool_max_shares = true;
     } else if ( code == 11 || code == 12 ) {
         m_been_banded_by_pool = true;
@@ -639,18 +970,22 @@ void CCommThread::Communicate() {
         NOSO_TUI_OutputStatPad( msgbuf );
         NOSO_TUI_OutputHistWin();
         NOSO_TUI_OutputStatWin();
+        std::shared_ptr<CTarget> target;
         if ( NOSO_BLOCK_AGE_OUTER_MINING_PERIOD ) {
+            // sleeping until the pre-arm, DEFAULT_POOL_PREARM_SECONDS before
+            // the mining period opens
+            auto const opening { noso_mining_period_opening() };
             awaiting_threads_wait_for(
-                    ( NOSO_BLOCK_AGE_BEHIND_MINING_PERIOD
-                            ? ( 600 - NOSO_BLOCK_AGE + 10 )
-                            : ( 10 - NOSO_BLOCK_AGE ) ) + 1,
+                    std::chrono::duration<double>( opening - std::chrono::steady_clock::now() ).count()
+                            - DEFAULT_POOL_PREARM_SECONDS,
                     std::this_thread::get_id(),
                     g_all_awaiting_threads,
-                    []() -> bool { return !g_still_running
-                            || NOSO_BLOCK_AGE_INNER_MINING_PERIOD; } );
+                    []() -> bool { return !g_still_running; } );
+            if ( !g_still_running ) break;
+            target = this->GetTargetPrearmed( prev_lb_hash, opening );
             if ( !g_still_running ) break;
         }
-        std::shared_ptr<CTarget> target = this->GetTarget( prev_lb_hash );
+        if ( target == nullptr ) target = this->GetTarget( prev_lb_hash );
         if ( !g_still_running ) break;
         if ( target == nullptr ) {
             std::snprintf( msgbuf, 100,
@@ -670,19 +1005,17 @@ void CCommThread::Communicate() {
         }
         std::strcpy( prev_lb_hash, target->lb_hash.c_str() );
         end_blck = begin_blck = std::chrono::steady_clock::now();
-        for ( auto const & mo : m_mine_objects ) mo->NewTarget( target );
+        m_remaining_pool_shares = pool_max_shares( target );
+        m_mine_job = m_scheduler.NewJob( m_pool_index, this, target );
         this->_ReportMiningTarget( target );
-        auto  pool_target { std::dynamic_pointer_cast<CPoolTarget>( target ) };
-        m_pool_max_shares = pool_target->max_shares;
         while ( g_still_running
                 && NOSO_BLOCK_AGE_INNER_MINING_PERIOD ) {
-            auto begin_submit = std::chrono::steady_clock::now();
-            std::shared_ptr<CSolution> solution = this->GetSolution();
-            if ( solution != nullptr && solution->diff < target->mn_diff )
-                this->SubmitSolution( solution, target );
+            this->ReconcileSubmissions( target, false );
+            this->SubmitSolutions( target );
             if ( this->IsBandedByPool() ) {
                 break;
             } else if ( this->ReachedMaxShares() ) {
+                this->ReconcileSubmissions( target, true );
                 end_blck = std::chrono::steady_clock::now();
                 std::snprintf( msgbuf, 100,
                         "Done target from pool %s. Take a rest",
@@ -698,15 +1031,13 @@ void CCommThread::Communicate() {
                         []() -> bool { return !g_still_running
                                 || NOSO_BLOCK_AGE_OUTER_MINING_PERIOD; } );
             } else {
-                if ( this->SolutionsCount() > 0 ) continue;
-                auto end_submit = std::chrono::steady_clock::now();
-                std::chrono::duration<double> elapsed_submit = end_submit - begin_submit;
-                if ( elapsed_submit.count() < DEFAULT_INET_CIRCLE_SECONDS ) {
-                    std::this_thread::sleep_for( std::chrono::milliseconds(
-                            static_cast<int>( 1'000 * DEFAULT_INET_CIRCLE_SECONDS ) ) );
-                }
+                // woken up by the next hit while another request may be
+                // started, by a request done or by the next retry due, no
+                // later than the end of the mining period
+                this->AwaitEvent( this->NextRetryTime(), this->CanSubmitSolution( target ), false );
             }
         }
+        this->ReconcileSubmissions( target, true );
         this->CloseMiningBlock( end_blck - begin_blck );
         this->_ReportTargetSummary( target );
         this->ResetMiningBlock();
@@ -714,7 +1045,6 @@ void CCommThread::Communicate() {
             break;
         }
     } // END while ( g_still_running ) {
-    for ( auto &obj : m_mine_objects ) obj->CleanupSyncState();
-    for ( auto &thr : m_mine_threads ) thr.join();
+    this->SettleSourceRequests();
 }
 
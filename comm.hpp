@@ -7,10 +7,17 @@
 
 #include <map>
 #include <set>
+#include <deque>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <future>
 #include <random>
+#include <chrono>
 #include <string>
+#include <vector>
 #include <cassert>
+#include <condition_variable>
 
 #include "noso-2m.hpp"
 #include "misc.hpp"
@@ -54,51 +61,136 @@ struct CPoolStatus {
     CPoolStatus( const char *ps );
 };
 
+// Estimates the offset of the network time to the steady clock, see
+// g_network_clock_offset, from the utc_time of the SOURCE responses of all
+// the pools. A response stamped U seconds to a request sent at t0 and done at
+// t1 on the steady clock bounds the offset within [U - t1, U + 1 - t0],
+// widened by DEFAULT_CLOCK_DRIFT_PPM as it ages. The offset taken is the
+// middle of the range the most bounds agree on (Marzullo's algorithm). It
+// narrows as the exchanges hit different fractions of a second, and leaves
+// out a pool whose clock is off the others
+class CNetworkClock {
+    struct CSample {
+        double lower;
+        double upper;
+        std::chrono::steady_clock::time_point time;
+    };
+    mutable std::mutex m_mutex_samples;
+    std::deque<CSample> m_samples;
+public:
+    void AddSample( std::time_t utc_time,
+            std::chrono::steady_clock::time_point sent_time,
+            std::chrono::steady_clock::time_point done_time );
+    bool Estimate( double & offset, double & uncertainty,
+            std::size_t & agreeing, std::size_t & samples ) const;
+};
+
+CNetworkClock & network_clock();
+
+// A SHARE request to a pool, with the buffers the reactor sends it from and
+// receives its response into while it is in flight. Its result is invalid
+// while it waits for its retry
+struct CShareSubmission {
+    CSolution solution;
+    std::uint32_t tries_count { 0 };
+    std::chrono::steady_clock::time_point retry_time;
+    std::future<int> result;
+    char inet_command[DEFAULT_INET_COMMAND_SIZE];
+    char inet_buffer[DEFAULT_INET_BUFFER_SIZE];
+};
+
+// A SOURCE request of the pre-arm, with its buffers
+struct CSourceRequest {
+    std::future<int> result;
+    std::chrono::steady_clock::time_point sent_time;
+    std::chrono::steady_clock::time_point done_time;
+    char inet_command[DEFAULT_INET_COMMAND_SIZE];
+    char inet_buffer[DEFAULT_INET_BUFFER_SIZE];
+};
+
 class CCommThread {
 public:
     pool_specs_t const m_pool;
 private:
     mutable std::default_random_engine m_random_engine {
             std::default_random_engine { std::random_device {}() } };
-    mutable std::mutex m_mutex_solutions;
-    std::vector<std::shared_ptr<CSolution>> m_pool_solutions;
+    CSolutionRing m_pool_solutions;
+    // the solutions of the running block waiting for submission, by their
+    // diff to its lb_hash and then their base, and the bases already got
+    std::map<std::string, CSolution> m_ranked_solutions;
+    std::set<std::string> m_solution_bases;
+    // the comm thread waits for hits on m_condv_wake, the mining threads
+    // notify it only while it is awaiting them
+    std::mutex m_mutex_wake;
+    std::shared_ptr<std::condition_variable> const m_condv_wake;
+    std::atomic<bool> m_awaiting_solutions { false };
+    // the SHARE requests in flight or waiting for their retry, the SOURCE
+    // requests of the last pre-arm, and the ones of each finished but not
+    // taken yet, counted apart under m_mutex_wake as the SOURCE requests
+    // left by a pre-arm are taken only by the next one
+    std::vector<std::unique_ptr<CShareSubmission>> m_submissions;
+    std::vector<std::unique_ptr<CSourceRequest>> m_source_requests;
+    std::uint32_t m_finished_requests { 0 };
+    std::uint32_t m_finished_sources { 0 };
     std::uint64_t m_last_block_hashes_count { 0 };
     double m_last_block_elapsed_secs { 0. };
     double m_last_block_hashrate { 0. };
-    bool m_reached_pool_max_shares { false };
-    bool m_been_banded_by_pool { false };
-    std::uint32_t m_pool_max_shares { DEFAULT_POOL_SHARES_LIMIT };
+    // written by the comm thread only and read by the mining threads
+    std::atomic<bool> m_reached_pool_max_shares { false };
+    std::atomic<bool> m_been_banded_by_pool { false };
+    std::atomic<std::uint32_t> m_remaining_pool_shares { 0 };
     std::uint32_t m_accepted_solutions_count { 0 };
     std::uint32_t m_rejected_solutions_count { 0 };
     std::uint32_t m_failured_solutions_count { 0 };
     struct addrinfo const * m_bind_serv;
     char m_inet_command[DEFAULT_INET_COMMAND_SIZE];
     char m_inet_buffer[DEFAULT_INET_BUFFER_SIZE];
-    std::vector<std::thread> m_mine_threads;
-    std::vector<std::shared_ptr<CMineThread>> m_mine_objects;
-    const std::shared_ptr<CSolution> GetSolution();
+    std::size_t const m_pool_index;
+    CMineScheduler & m_scheduler;
+    std::shared_ptr<CMineJob> m_mine_job;
+    void RankSolutions( std::shared_ptr<CTarget> const & target );
+    bool GetSolution( std::shared_ptr<CTarget> const & target, CSolution & solution );
+    void RetrySolution( std::shared_ptr<CTarget> const & target, CSolution const & solution );
     void ClearSolutions();
-    std::size_t SolutionsCount();
+    bool HasSolutions() const;
+    void AwaitEvent( std::chrono::steady_clock::time_point until, bool solutions, bool sources );
     std::shared_ptr<CPoolTarget> RequestPoolTarget( const char address[32] );
+    std::shared_ptr<CPoolTarget> ParsePoolTarget( const char address[32], int rsize,
+            char * inet_command, char * inet_buffer );
+    void RequestDone( std::uint32_t & finished );
+    void RequestTaken( std::uint32_t & finished );
+    void StartSourceRequest( std::chrono::steady_clock::time_point send_time );
+    void SettleSourceRequests();
+    std::shared_ptr<CTarget> GetTargetPrearmed( const char prev_lb_hash[32],
+            std::chrono::steady_clock::time_point opening );
     std::shared_ptr<CPoolTarget> GetPoolTargetRetrying();
     std::shared_ptr<CTarget> GetTarget( const char prev_lb_hash[32] );
-    int SubmitPoolSolution( std::uint32_t blck_no, const char base[19], const char address[32] );
+    void StartSubmission( CShareSubmission & submission );
+    int ParseSubmission( CShareSubmission & submission, int rsize );
+    void SubmitSolutions( std::shared_ptr<CTarget> const & target );
+    void ReconcileSubmissions( std::shared_ptr<CTarget> const & target, bool finishing );
+    bool CanSubmitSolution( std::shared_ptr<CTarget> const & target ) const;
+    std::chrono::steady_clock::time_point NextRetryTime() const;
     void CloseMiningBlock( const std::chrono::duration<double>& elapsed_blck );
     void ResetMiningBlock();
     void _ReportMiningTarget( const std::shared_ptr<CTarget>& target );
     void _ReportTargetSummary( const std::shared_ptr<CTarget>& target );
+#ifdef NOSO_PROFILE
+    void _ReportStageProfiles( std::uint32_t blck_no );
+#endif // NOSO_PROFILE
 public:
-    CCommThread( std::uint32_t threads_count, pool_specs_t const & pool,
-            struct addrinfo const * bind_serv );
+    CCommThread( std::size_t pool_index, pool_specs_t const & pool,
+            CMineScheduler & scheduler, struct addrinfo const * bind_serv );
     CCommThread( const CCommThread& ) = delete; // Copy prohibited
     CCommThread( CCommThread&& ) = delete; // Move prohibited
     void operator=( const CCommThread& ) = delete; // Assignment prohibited
     CCommThread& operator=( CCommThread&& ) = delete; // Move assignment prohibited
-    void AddSolution( const std::shared_ptr<CSolution>& solution );
-    void SubmitSolution( std::shared_ptr<CSolution> const & solution,
+    void AddSolution( CSolution const & solution );
+    void SubmitSolution( CSolution const & solution, int code,
             std::shared_ptr<CTarget> const & target );
     bool IsBandedByPool();
     bool ReachedMaxShares();
+    std::uint32_t RemainingShares();
     void Communicate();
 };
 
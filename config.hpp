@@ -13,15 +13,36 @@
 #define DEFAULT_MINER_ADDRESS           "NbGP2VXhtkJSbEtHYz2uNfKRo34YDq"
 
 #define DEFAULT_POOL_SHARES_LIMIT       5
-#define DEFAULT_POOL_THREADS_COUNT      1
+#define DEFAULT_POOL_INFLIGHT_SHARES    4
+#define DEFAULT_POOL_WEIGHT             1
+#define DEFAULT_MINING_THREADS_COUNT    1
 #define DEFAULT_POOL_RETRIES_COUNT      4
 #define DEFAULT_POOL_INET_TIMEOSEC      60
+#define DEFAULT_POOL_PREARM_SECONDS     2
+#define DEFAULT_POOL_HEDGE_SECONDS      0.2
+#define DEFAULT_POOL_HEDGES_COUNT       10
 #define DEFAULT_INET_CIRCLE_SECONDS     0.1
 #define DEFAULT_INET_COMMAND_SIZE       512
 #define DEFAULT_INET_BUFFER_SIZE        2048
+#define DEFAULT_INET_REACTOR_MSECS      10
+#define DEFAULT_INET_RESOLVE_TTLSEC     300
+#define DEFAULT_INET_RESOLVE_RETRYSEC   10
+#define DEFAULT_INET_RESOLVE_RETRIES    3
+#define DEFAULT_SOLUTIONS_RING_SIZE     256
 #define DEFAULT_LOGGING_LEVEL           "info"
 #define DEFAULT_BINDING_IPV4ADDR        "none"
+#define DEFAULT_HASHING_KERNEL          "auto"
+#define DEFAULT_THREADS_AFFINITY        "none"
+#define DEFAULT_HASHING_RANGE           4096
+#define DEFAULT_BENCH_FILENAME          "noso-2m-bench.json"
+#define DEFAULT_BENCH_SECONDS           2.0
+#define DEFAULT_TUNE_FILENAME           "noso-2m-tune.txt"
+#define DEFAULT_TUNE_SECONDS            0.5
 #define DEFAULT_TIMESTAMP_DIFFERENCES   3
+#define DEFAULT_CLOCK_SAMPLES_COUNT     64
+#define DEFAULT_CLOCK_SAMPLES_SECONDS   3600
+#define DEFAULT_CLOCK_MAX_RTT_SECONDS   2.0
+#define DEFAULT_CLOCK_DRIFT_PPM         20
 
 #endif // __NOSO2M_CONFIG_HPP__
 
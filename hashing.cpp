@@ -2,9 +2,15 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include <bit>
 #include <cstring>
 
 #include "hashing.hpp"
+#include "profile.hpp"
+
+#ifdef NOSO_HASHING_X86
+#include <immintrin.h>
+#endif // NOSO_HASHING_X86
 
 constexpr char const CNosoHasher::hex_dec2char_table[];
 constexpr char const CNosoHasher::hex_char2dec_table[];
@@ -29,8 +35,19 @@ void CNosoHasher::_init( char const prefix[10], char const address[32] ) {
     m_diff[32] = '\0';
 }
 
+inline
+void CNosoHasher::_cache() {
+    std::memcpy( m_stat_cache[0], m_stat, 128 );
+    for( size_t row = 1; row <= 128; ++row ) {
+        std::uint8_t const * prev = m_stat_cache[row - 1];
+        for( size_t col = 0; col < 128; ++col )
+            m_stat_cache[row][col] = nosohash_chars_table[prev[col] + prev[( col + 1 ) % 128]];
+    }
+}
+
 inline
 void CNosoHasher::_itoa( std::uint32_t n ) {
+    NOSO_PROFILE_STAGE( CNosoStage::ITOA, 1 );
              n = n % 1'000'000'000;
     m_stat[ 9] = n /   100'000'000 + '0';
              n = n %   100'000'000;
@@ -51,21 +68,140 @@ void CNosoHasher::_itoa( std::uint32_t n ) {
     m_stat[17] = n                 + '0';
 }
 
+// Steps the nonce columns 9..17 on to the next counter as an odometer does,
+// the carries rarely go past the last columns
+inline
+void CNosoHasher::_next() {
+    NOSO_PROFILE_STAGE( CNosoStage::ITOA, 1 );
+    std::size_t col { 17 };
+    while ( m_stat[col] == '9' && col > 9 ) m_stat[col--] = '0';
+    m_stat[col] = m_stat[col] == '9' ? '0' : m_stat[col] + 1;
+}
+
+// nosohash_chars_table[a + b] for a, b in [32, 126] wraps a + b into [32, 126]
+// by subtracting 95 once or twice, and a + b <= 252 never overflows a byte.
+// Here on the 8 bytes of a word at once: the high bit of a byte of sum + 1 is
+// set for a + b >= 127, and the one of sum / 2 + 17 for a + b >= 222
+inline
+std::uint64_t nosohash_wrap( std::uint64_t sum ) {
+    constexpr std::uint64_t const ones { 0x0101010101010101ull };
+    std::uint64_t const ge1 { ( ( sum + ones ) >> 7 ) & ones };
+    std::uint64_t const ge2 { ( ( ( ( sum >> 1 ) & ( 0x7F * ones ) ) + 17 * ones ) >> 7 ) & ones };
+    return sum - 95 * ge1 - 95 * ge2;
+}
+
+// After `row` mixing steps the column col depends on the initial columns
+// col..col+row (wrapping at 128), so a column is the same for every nonce as
+// long as it is not reached by the nonce columns 9..17, or for every nonce
+// sharing the columns 9..shared-1 as long as it is not reached by shared..17
+constexpr inline
+bool nosohash_invariant( std::size_t row, std::size_t col, std::size_t shared = 9 ) {
+    return ( 18 <= col && col + row < 128 + shared ) || ( col + row < shared );
+}
+
+// The row is kept as 16 words, the col + 1 operand is the row shifted by one
+// byte, and words with no column reached by the nonce yet are read from the cache
+inline
+void nosohash_stat_scalar( std::uint8_t stat_1[129], std::uint8_t const cache[129][128] ) {
+    std::uint64_t curr[16];
+    std::memcpy( curr, stat_1, 128 );
+    for( size_t row = 1; row <= 128; ++row ) {
+        std::uint64_t const first = curr[0];
+        for( size_t i = 0; i < 16; ++i ) {
+            if ( i > 2 && nosohash_invariant( row, 8 * i + 7 ) ) {
+                std::memcpy( curr + i, cache[row] + 8 * i, 8 );
+                continue;
+            }
+            std::uint64_t const succ { i < 15 ? curr[i + 1] : first };
+            std::uint64_t const next { std::endian::native == std::endian::little
+                    ? ( curr[i] >> 8 ) | ( succ << 56 )
+                    : ( curr[i] << 8 ) | ( succ >> 56 ) };
+            curr[i] = nosohash_wrap( curr[i] + next );
+        }
+    }
+    std::memcpy( stat_1, curr, 128 );
+    stat_1[128]=stat_1[0];
+}
+
+#ifdef NOSO_HASHING_X86
+// The whole row stays in registers for the 128 steps, the col + 1 operand is
+// the row rotated left by one byte so that col 128 reads col 0. Vectors with
+// no column reached by the nonce yet are loaded from the cache
+__attribute__(( target( "sse2" ) ))
+void nosohash_stat_sse2( std::uint8_t stat_1[129], std::uint8_t const cache[129][128] ) {
+    __m128i const lim1 = _mm_set1_epi8( (char)127 );
+    __m128i const lim2 = _mm_set1_epi8( (char)222 );
+    __m128i const step = _mm_set1_epi8( (char)95 );
+    __m128i * const stat = reinterpret_cast<__m128i *>( stat_1 );
+    __m128i curr[8];
+    for ( size_t i = 0; i < 8; ++i ) curr[i] = _mm_loadu_si128( stat + i );
+    for( size_t row = 1; row <= 128; ++row ) {
+        __m128i const first = curr[0];
+        for ( size_t i = 0; i < 8; ++i ) {
+            if ( i > 1 && nosohash_invariant( row, 16 * i + 15 ) ) {
+                curr[i] = _mm_load_si128( reinterpret_cast<__m128i const *>( cache[row] ) + i );
+                continue;
+            }
+            __m128i const next = _mm_or_si128( _mm_srli_si128( curr[i], 1 ),
+                    _mm_slli_si128( i < 7 ? curr[i + 1] : first, 15 ) );
+            __m128i sum = _mm_add_epi8( curr[i], next );
+            __m128i const ge1 = _mm_cmpeq_epi8( _mm_max_epu8( sum, lim1 ), sum );
+            __m128i const ge2 = _mm_cmpeq_epi8( _mm_max_epu8( sum, lim2 ), sum );
+            sum = _mm_sub_epi8( sum, _mm_and_si128( ge1, step ) );
+            curr[i] = _mm_sub_epi8( sum, _mm_and_si128( ge2, step ) );
+        }
+    }
+    for ( size_t i = 0; i < 8; ++i ) _mm_storeu_si128( stat + i, curr[i] );
+    stat_1[128]=stat_1[0];
+}
+
+__attribute__(( target( "avx2" ) ))
+void nosohash_stat_avx2( std::uint8_t stat_1[129], std::uint8_t const cache[129][128] ) {
+    __m256i const lim1 = _mm256_set1_epi8( (char)127 );
+    __m256i const lim2 = _mm256_set1_epi8( (char)222 );
+    __m256i const step = _mm256_set1_epi8( (char)95 );
+    __m256i * const stat = reinterpret_cast<__m256i *>( stat_1 );
+    __m256i curr[4];
+    for ( size_t i = 0; i < 4; ++i ) curr[i] = _mm256_loadu_si256( stat + i );
+    for( size_t row = 1; row <= 128; ++row ) {
+        __m256i const first = curr[0];
+        for ( size_t i = 0; i < 4; ++i ) {
+            if ( i > 0 && nosohash_invariant( row, 32 * i + 31 ) ) {
+                curr[i] = _mm256_load_si256( reinterpret_cast<__m256i const *>( cache[row] ) + i );
+                continue;
+            }
+            __m256i const next = _mm256_alignr_epi8( _mm256_permute2x128_si256(
+                    curr[i], i < 3 ? curr[i + 1] : first, 0x21 ), curr[i], 1 );
+            __m256i sum = _mm256_add_epi8( curr[i], next );
+            __m256i const ge1 = _mm256_cmpeq_epi8( _mm256_max_epu8( sum, lim1 ), sum );
+            __m256i const ge2 = _mm256_cmpeq_epi8( _mm256_max_epu8( sum, lim2 ), sum );
+            sum = _mm256_sub_epi8( sum, _mm256_and_si256( ge1, step ) );
+            curr[i] = _mm256_sub_epi8( sum, _mm256_and_si256( ge2, step ) );
+        }
+    }
+    for ( size_t i = 0; i < 4; ++i ) _mm256_storeu_si256( stat + i, curr[i] );
+    stat_1[128]=stat_1[0];
+}
+#endif // NOSO_HASHING_X86
+
 inline
 void CNosoHasher::_stat() {
-    char * stat_1 = m_stat + 129;
+    NOSO_PROFILE_STAGE( CNosoStage::STAT, 1 );
+    std::uint8_t * stat_1 = reinterpret_cast<std::uint8_t *>( m_stat + 129 );
     std::memcpy( stat_1, m_stat, 128 );
     stat_1[128]=stat_1[0];
-    for( size_t row = 0; row < 128; ++row ) {
-        for( size_t col = 0; col < 128; ++col ) {
-            stat_1[col] = nosohash_chars_table[stat_1[col + 0] + stat_1[col + 1]];
-        }
-        stat_1[128]=stat_1[0];
+    switch ( m_stat_kernel ) {
+#ifdef NOSO_HASHING_X86
+    case CNosoStatKernel::AVX2: nosohash_stat_avx2( stat_1, m_stat_cache ); break;
+    case CNosoStatKernel::SSE2: nosohash_stat_sse2( stat_1, m_stat_cache ); break;
+#endif // NOSO_HASHING_X86
+    default: nosohash_stat_scalar( stat_1, m_stat_cache ); break;
     }
 }
 
 inline
 void CNosoHasher::_pack() {
+    NOSO_PROFILE_STAGE( CNosoStage::PACK, 1 );
     m_hash[ 0] = hex_dec2char_table[nosohash_chars_table[m_stat[129+  0]+m_stat[129+  1]+m_stat[129+  2]+m_stat[129+  3]]%16];
     m_hash[ 1] = hex_dec2char_table[nosohash_chars_table[m_stat[129+  4]+m_stat[129+  5]+m_stat[129+  6]+m_stat[129+  7]]%16];
     m_hash[ 2] = hex_dec2char_table[nosohash_chars_table[m_stat[129+  8]+m_stat[129+  9]+m_stat[129+ 10]+m_stat[129+ 11]]%16];
@@ -103,43 +239,54 @@ void CNosoHasher::_pack() {
 
 inline
 void CNosoHasher::_md5d() {
+    NOSO_PROFILE_STAGE( CNosoStage::MD5D, 1 );
     assert( std::strlen( m_hash ) == 32 );
-    md5Init( &m_md5_ctx );
-    md5Update( &m_md5_ctx, (uint8_t *)m_hash, 32 );
-    md5Finalize( &m_md5_ctx );
-    m_hash[ 0] = hex_dec2char_table[m_md5_ctx.digest[ 0] >>  4];
-    m_hash[ 1] = hex_dec2char_table[m_md5_ctx.digest[ 0] & 0xF];
-    m_hash[ 2] = hex_dec2char_table[m_md5_ctx.digest[ 1] >>  4];
-    m_hash[ 3] = hex_dec2char_table[m_md5_ctx.digest[ 1] & 0xF];
-    m_hash[ 4] = hex_dec2char_table[m_md5_ctx.digest[ 2] >>  4];
-    m_hash[ 5] = hex_dec2char_table[m_md5_ctx.digest[ 2] & 0xF];
-    m_hash[ 6] = hex_dec2char_table[m_md5_ctx.digest[ 3] >>  4];
-    m_hash[ 7] = hex_dec2char_table[m_md5_ctx.digest[ 3] & 0xF];
-    m_hash[ 8] = hex_dec2char_table[m_md5_ctx.digest[ 4] >>  4];
-    m_hash[ 9] = hex_dec2char_table[m_md5_ctx.digest[ 4] & 0xF];
-    m_hash[10] = hex_dec2char_table[m_md5_ctx.digest[ 5] >>  4];
-    m_hash[11] = hex_dec2char_table[m_md5_ctx.digest[ 5] & 0xF];
-    m_hash[12] = hex_dec2char_table[m_md5_ctx.digest[ 6] >>  4];
-    m_hash[13] = hex_dec2char_table[m_md5_ctx.digest[ 6] & 0xF];
-    m_hash[14] = hex_dec2char_table[m_md5_ctx.digest[ 7] >>  4];
-    m_hash[15] = hex_dec2char_table[m_md5_ctx.digest[ 7] & 0xF];
-    m_hash[16] = hex_dec2char_table[m_md5_ctx.digest[ 8] >>  4];
-    m_hash[17] = hex_dec2char_table[m_md5_ctx.digest[ 8] & 0xF];
-    m_hash[18] = hex_dec2char_table[m_md5_ctx.digest[ 9] >>  4];
-    m_hash[19] = hex_dec2char_table[m_md5_ctx.digest[ 9] & 0xF];
-    m_hash[20] = hex_dec2char_table[m_md5_ctx.digest[10] >>  4];
-    m_hash[21] = hex_dec2char_table[m_md5_ctx.digest[10] & 0xF];
-    m_hash[22] = hex_dec2char_table[m_md5_ctx.digest[11] >>  4];
-    m_hash[23] = hex_dec2char_table[m_md5_ctx.digest[11] & 0xF];
-    m_hash[24] = hex_dec2char_table[m_md5_ctx.digest[12] >>  4];
-    m_hash[25] = hex_dec2char_table[m_md5_ctx.digest[12] & 0xF];
-    m_hash[26] = hex_dec2char_table[m_md5_ctx.digest[13] >>  4];
-    m_hash[27] = hex_dec2char_table[m_md5_ctx.digest[13] & 0xF];
-    m_hash[28] = hex_dec2char_table[m_md5_ctx.digest[14] >>  4];
-    m_hash[29] = hex_dec2char_table[m_md5_ctx.digest[14] & 0xF];
-    m_hash[30] = hex_dec2char_table[m_md5_ctx.digest[15] >>  4];
-    m_hash[31] = hex_dec2char_table[m_md5_ctx.digest[15] & 0xF];
-    assert( std::strlen( m_hash ) == 32 );
+    md5_32bytes_x1( (std::uint8_t const *)m_hash, m_digest );
+}
+
+#ifdef NOSO_HASHING_X86
+inline
+void CNosoHasher::_md5d_x4() {
+    NOSO_PROFILE_STAGE( CNosoStage::MD5D, 4 );
+    md5_32bytes_x4_sse2( (std::uint8_t const *)m_packs, sizeof( m_packs[0] ), m_digests );
+}
+#endif // NOSO_HASHING_X86
+
+inline
+void CNosoHasher::_hexd( char hash[33] ) const {
+    hash[ 0] = hex_dec2char_table[m_digest[ 0] >>  4];
+    hash[ 1] = hex_dec2char_table[m_digest[ 0] & 0xF];
+    hash[ 2] = hex_dec2char_table[m_digest[ 1] >>  4];
+    hash[ 3] = hex_dec2char_table[m_digest[ 1] & 0xF];
+    hash[ 4] = hex_dec2char_table[m_digest[ 2] >>  4];
+    hash[ 5] = hex_dec2char_table[m_digest[ 2] & 0xF];
+    hash[ 6] = hex_dec2char_table[m_digest[ 3] >>  4];
+    hash[ 7] = hex_dec2char_table[m_digest[ 3] & 0xF];
+    hash[ 8] = hex_dec2char_table[m_digest[ 4] >>  4];
+    hash[ 9] = hex_dec2char_table[m_digest[ 4] & 0xF];
+    hash[10] = hex_dec2char_table[m_digest[ 5] >>  4];
+    hash[11] = hex_dec2char_table[m_digest[ 5] & 0xF];
+    hash[12] = hex_dec2char_table[m_digest[ 6] >>  4];
+    hash[13] = hex_dec2char_table[m_digest[ 6] & 0xF];
+    hash[14] = hex_dec2char_table[m_digest[ 7] >>  4];
+    hash[15] = hex_dec2char_table[m_digest[ 7] & 0xF];
+    hash[16] = hex_dec2char_table[m_digest[ 8] >>  4];
+    hash[17] = hex_dec2char_table[m_digest[ 8] & 0xF];
+    hash[18] = hex_dec2char_table[m_digest[ 9] >>  4];
+    hash[19] = hex_dec2char_table[m_digest[ 9] & 0xF];
+    hash[20] = hex_dec2char_table[m_digest[10] >>  4];
+    hash[21] = hex_dec2char_table[m_digest[10] & 0xF];
+    hash[22] = hex_dec2char_table[m_digest[11] >>  4];
+    hash[23] = hex_dec2char_table[m_digest[11] & 0xF];
+    hash[24] = hex_dec2char_table[m_digest[12] >>  4];
+    hash[25] = hex_dec2char_table[m_digest[12] & 0xF];
+    hash[26] = hex_dec2char_table[m_digest[13] >>  4];
+    hash[27] = hex_dec2char_table[m_digest[13] & 0xF];
+    hash[28] = hex_dec2char_table[m_digest[14] >>  4];
+    hash[29] = hex_dec2char_table[m_digest[14] & 0xF];
+    hash[30] = hex_dec2char_table[m_digest[15] >>  4];
+    hash[31] = hex_dec2char_table[m_digest[15] & 0xF];
+    hash[32] = '\0';
 }
 
 void CNosoHasher::_diff( char const target[33] ) {
@@ -180,10 +327,31 @@ void CNosoHasher::_diff( char const target[33] ) {
     assert( std::strlen( m_diff ) == 32 );
 }
 
+CNosoHasher::CNosoHasher( CNosoStatKernel stat_kernel )
+    :   m_stat_kernel { stat_kernel } {
+    assert( CNosoHasher::IsSupported( stat_kernel ) );
+}
+
+bool CNosoHasher::IsSupported( CNosoStatKernel stat_kernel ) {
+    #if defined( NOSO_HASHING_X86 ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+    __builtin_cpu_init();
+    if ( stat_kernel == CNosoStatKernel::AVX2 ) return __builtin_cpu_supports( "avx2" );
+    if ( stat_kernel == CNosoStatKernel::SSE2 ) return __builtin_cpu_supports( "sse2" );
+    #endif
+    return stat_kernel == CNosoStatKernel::SCALAR;
+}
+
+CNosoStatKernel CNosoHasher::BestStatKernel() {
+    return CNosoHasher::IsSupported( CNosoStatKernel::AVX2 ) ? CNosoStatKernel::AVX2
+        : CNosoHasher::IsSupported( CNosoStatKernel::SSE2 ) ? CNosoStatKernel::SSE2
+        : CNosoStatKernel::SCALAR;
+}
+
 void CNosoHasher::Init( char const prefix[10], char const address[32] ) {
     assert( std::strlen( prefix ) == 9
             && ( std::strlen( address ) == 30 || std::strlen( address ) == 31 ) );
     this->_init( prefix, address );
+    this->_cache();
     assert( std::strlen( m_base ) == 18 );
 }
 
@@ -198,6 +366,7 @@ char const * CNosoHasher::GetHash() {
     this->_stat();
     this->_pack();
     this->_md5d();
+    this->_hexd( m_hash );
     assert( std::strlen( m_hash ) == 32 );
     return m_hash;
 }
@@ -210,6 +379,396 @@ char const * CNosoHasher::GetDiff( char const target[33] ) {
     return m_diff;
 }
 
+// the difference GetDiff gives for any hash, as the pools grade shares
+void CNosoHasher::Diff( char const hash[33], char const target[33], char diff[33] ) {
+    assert( std::strlen( hash ) == 32
+           && std::strlen( target ) == 32 );
+    for ( std::size_t i = 0; i < 32; ++i )
+        diff[i] = hex_dec2char_table[std::abs( hex_char2dec_table[(int)hash[i]] - hex_char2dec_table[(int)target[i]] )];
+    diff[32] = '\0';
+}
+
+char const ( * CNosoHasher::GetHashes( std::uint32_t counter ) )[33] {
+    this->GetBase( counter );
+    this->GetHash();
+    return &m_hash;
+}
+
+CNosoHashTarget::CNosoHashTarget( char const prefix[33], std::size_t match_len )
+    :   value { 0, 0 }, mask { 0, 0 } {
+    assert( match_len <= 32 && std::strlen( prefix ) >= match_len );
+    for ( std::size_t i = 0; i < match_len; ++i ) {
+        char const c = prefix[i];
+        std::uint64_t const nibble = c <= '9' ? c - '0' : ( c | 0x20 ) - 'a' + 10;
+        std::size_t const shift { 60 - 4 * ( i % 16 ) };
+        value[i / 16] |= nibble << shift;
+        mask[i / 16] |= std::uint64_t( 0xF ) << shift;
+    }
+}
+
+// Hashes the nonces counter_begin .. counter_begin + count - 1 and appends to
+// out_hits the ones whose hash starts with the target prefix. Hashes are only
+// compared as digests and hex-encoded for the hits. Returns the number of
+// hashes computed. With a SIMD row kernel the packed hashes of 4 nonces at a
+// time are digested together by the SSE2 MD5, the last count % 4 ones alone
+std::uint32_t CNosoHasher::HashRange( std::uint32_t counter_begin, std::uint32_t count,
+        CNosoHashTarget const & target, std::vector<CNosoHashHit> & out_hits ) {
+    this->_itoa( counter_begin );
+    std::uint32_t counter { counter_begin };
+#ifdef NOSO_HASHING_X86
+    if ( m_stat_kernel != CNosoStatKernel::SCALAR ) {
+        for ( ; counter_begin + count - counter >= 4; counter += 4 ) {
+            for ( std::size_t lane = 0; lane < 4; ++lane ) {
+                if ( counter + lane != counter_begin ) this->_next();
+                this->_stat();
+                this->_pack();
+                std::memcpy( m_packs[lane], m_hash, sizeof( m_packs[lane] ) );
+            }
+            this->_md5d_x4();
+            NOSO_PROFILE_STAGE( CNosoStage::CHECK, 4 );
+            for ( std::size_t lane = 0; lane < 4; ++lane ) {
+                if ( !target.Match( m_digests[lane] ) ) continue;
+                std::memcpy( m_digest, m_digests[lane], sizeof( m_digest ) );
+                out_hits.push_back( { counter + std::uint32_t( lane ), "" } );
+                this->_hexd( out_hits.back().hash );
+            }
+        }
+    }
+#endif // NOSO_HASHING_X86
+    for ( ; counter != counter_begin + count; ++counter ) {
+        if ( counter != counter_begin ) this->_next();
+        this->_stat();
+        this->_pack();
+        this->_md5d();
+        NOSO_PROFILE_STAGE( CNosoStage::CHECK, 1 );
+        if ( target.Match( m_digest ) ) {
+            out_hits.push_back( { counter, "" } );
+            this->_hexd( out_hits.back().hash );
+        }
+    }
+    return count;
+}
+
+std::uint32_t CNosoHasher::HashRange( std::uint32_t counter_begin, std::uint32_t count,
+        char const match_prefix[33], std::size_t match_len, std::vector<CNosoHashHit> & out_hits ) {
+    return this->HashRange( counter_begin, count, CNosoHashTarget { match_prefix, match_len }, out_hits );
+}
+
+#ifdef NOSO_HASHING_X86
+template <CNosoHashKernel KERNEL>
+bool CNosoHasherLanes<KERNEL>::IsSupported() {
+    if constexpr ( KERNEL == CNosoHashKernel::AVX512 ) {
+        #if defined( __GNUC__ ) || defined( __clang__ )
+        __builtin_cpu_init();
+        return __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" );
+        #else
+        return false;
+        #endif
+    }
+    return CNosoHasher::IsSupported( CNosoStatKernel::AVX2 );
+}
+
+template <CNosoHashKernel KERNEL>
+void CNosoHasherLanes<KERNEL>::Init( char const prefix[10], char const address[32] ) {
+    assert( std::strlen( prefix ) == 9
+            && ( std::strlen( address ) == 30 || std::strlen( address ) == 31 ) );
+    CNosoHasher hasher;
+    hasher.Init( prefix, address );
+    std::memcpy( m_stat_cache, hasher.m_stat_cache, sizeof( m_stat_cache ) );
+    for ( std::size_t col = 0; col < 128; ++col )
+        std::memset( m_init[col], hasher.m_stat[col], LANES );
+    m_counter = 1; // not 0, for _itoa to write all the digits
+    this->_itoa( 0 );
+    std::memcpy( m_base, hasher.m_base, 18 );
+    m_base[18] = '\0';
+    for ( std::size_t lane = 0; lane < LANES; ++lane ) m_hash[lane][32] = '\0';
+}
+
+inline
+void nosohash_itoa9( std::uint32_t n, char digits[9] ) {
+    n = n % 1'000'000'000;
+    for ( int i = 8; i >= 0; --i ) {
+        digits[i] = n % 10 + '0';
+        n = n / 10;
+    }
+}
+
+// Writes the nonce columns of the lanes into m_init. When the counter follows
+// the last one the digits of every lane are stepped on LANES nonces as an
+// odometer, where the carries rarely go past the last two columns. Then finds
+// the columns 9..m_shared-1 that all the lanes share and brings the cache up
+// to date with them
+template <CNosoHashKernel KERNEL>
+inline
+void CNosoHasherLanes<KERNEL>::_itoa( std::uint32_t counter ) {
+    NOSO_PROFILE_STAGE( CNosoStage::ITOA, LANES );
+    if ( counter == m_counter + LANES ) {
+        for ( std::size_t lane = 0; lane < LANES; ++lane ) {
+            std::uint32_t carry { LANES };
+            for ( std::size_t col = 17; carry > 0 && col >= 9; --col ) {
+                std::uint32_t const digit { m_init[col][lane] - '0' + carry };
+                m_init[col][lane] = digit % 10 + '0';
+                carry = digit / 10;
+            }
+        }
+    } else if ( counter != m_counter ) {
+        char digits[9];
+        for ( std::size_t lane = 0; lane < LANES; ++lane ) {
+            nosohash_itoa9( counter + lane, digits );
+            for ( std::size_t col = 0; col < 9; ++col )
+                m_init[9 + col][lane] = digits[col];
+        }
+    }
+    m_counter = counter;
+    // the lanes hold consecutive nonces, the first and the last one share the
+    // columns all of them share
+    m_shared = 9;
+    while ( m_shared < 17 && m_init[m_shared][0] == m_init[m_shared][LANES - 1] ) ++m_shared;
+    this->_cache();
+}
+
+// m_stat_cache holds the rows of the nonce whose columns are in its row 0. When
+// that nonce does not share the columns 9..m_shared-1 with the lanes, the ones
+// from the first that differs are replaced and only the cells reached by them,
+// and not by the column 17 the lanes never share, are recomputed. That is up to
+// 8 cells per row, the cells reached by no nonce column are never touched
+template <CNosoHashKernel KERNEL>
+inline
+void CNosoHasherLanes<KERNEL>::_cache() {
+    std::size_t first { 9 };
+    while ( first < m_shared && m_stat_cache[0][first] == m_init[first][0] ) ++first;
+    if ( first == m_shared ) return;
+    for ( std::size_t col = first; col < 17; ++col ) m_stat_cache[0][col] = m_init[col][0];
+    for ( std::size_t row = 1; row <= 128; ++row ) {
+        for ( std::size_t col = first + 128 - row; col < 17 + 128 - row; ++col ) {
+            std::uint8_t const * prev = m_stat_cache[row - 1];
+            m_stat_cache[row][col % 128] = CNosoHasher::nosohash_chars_table[
+                    prev[col % 128] + prev[( col + 1 ) % 128]];
+        }
+    }
+}
+
+template <>
+__attribute__(( target( "avx2" ) ))
+void CNosoHasherLanes<CNosoHashKernel::AVX2>::_stat() {
+    NOSO_PROFILE_STAGE( CNosoStage::STAT, LANES );
+    // same wrapping of a + b into [32, 126] as nosohash_stat_scalar, and only
+    // the columns reached by the nonce columns the lanes do not share are
+    // computed, the others are read from the cache, see _cache
+    __m256i const lim1 = _mm256_set1_epi8( (char)127 );
+    __m256i const lim2 = _mm256_set1_epi8( (char)222 );
+    __m256i const step = _mm256_set1_epi8( (char)95 );
+    __m256i * const stat = reinterpret_cast<__m256i *>( m_stat );
+    for ( std::size_t row = 1; row <= 128; ++row ) {
+        _mm256_store_si256( stat + 128, _mm256_load_si256( stat + 0 ) );
+        std::size_t const lo_l = row < m_shared ? m_shared - row : 0;
+        std::size_t const lo_r = row < 110 + m_shared ? 128 + m_shared - row : 18;
+        // the only cached columns read by the computed ones
+        for ( std::size_t col : { lo_l, std::size_t( 18 ), lo_r } ) {
+            if ( col < 128 && nosohash_invariant( row - 1, col, m_shared ) )
+                _mm256_store_si256( stat + col, _mm256_set1_epi8( (char)m_stat_cache[row - 1][col] ) );
+        }
+        std::size_t const ranges[2][2] { { lo_l, 18 }, { lo_r, 128 } };
+        for ( auto const & range : ranges ) {
+            __m256i curr = _mm256_load_si256( stat + range[0] );
+            for ( std::size_t col = range[0]; col < range[1]; ++col ) {
+                __m256i const next = _mm256_load_si256( stat + col + 1 );
+                __m256i sum = _mm256_add_epi8( curr, next );
+                __m256i const ge1 = _mm256_cmpeq_epi8( _mm256_max_epu8( sum, lim1 ), sum );
+                __m256i const ge2 = _mm256_cmpeq_epi8( _mm256_max_epu8( sum, lim2 ), sum );
+                sum = _mm256_sub_epi8( sum, _mm256_and_si256( ge1, step ) );
+                sum = _mm256_sub_epi8( sum, _mm256_and_si256( ge2, step ) );
+                _mm256_store_si256( stat + col, sum );
+                curr = next;
+            }
+        }
+    }
+}
+
+template <>
+__attribute__(( target( "avx512f,avx512bw" ) ))
+void CNosoHasherLanes<CNosoHashKernel::AVX512>::_stat() {
+    NOSO_PROFILE_STAGE( CNosoStage::STAT, LANES );
+    // as the AVX2 kernel, with the wrapping subtractions masked by compares
+    __m512i const lim1 = _mm512_set1_epi8( (char)127 );
+    __m512i const lim2 = _mm512_set1_epi8( (char)222 );
+    __m512i const step = _mm512_set1_epi8( (char)95 );
+    __m512i * const stat = reinterpret_cast<__m512i *>( m_stat );
+    for ( std::size_t row = 1; row <= 128; ++row ) {
+        _mm512_store_si512( stat + 128, _mm512_load_si512( stat + 0 ) );
+        std::size_t const lo_l = row < m_shared ? m_shared - row : 0;
+        std::size_t const lo_r = row < 110 + m_shared ? 128 + m_shared - row : 18;
+        for ( std::size_t col : { lo_l, std::size_t( 18 ), lo_r } ) {
+            if ( col < 128 && nosohash_invariant( row - 1, col, m_shared ) )
+                _mm512_store_si512( stat + col, _mm512_set1_epi8( (char)m_stat_cache[row - 1][col] ) );
+        }
+        std::size_t const ranges[2][2] { { lo_l, 18 }, { lo_r, 128 } };
+        for ( auto const & range : ranges ) {
+            __m512i curr = _mm512_load_si512( stat + range[0] );
+            for ( std::size_t col = range[0]; col < range[1]; ++col ) {
+                __m512i const next = _mm512_load_si512( stat + col + 1 );
+                __m512i sum = _mm512_add_epi8( curr, next );
+                __mmask64 const ge1 = _mm512_cmpge_epu8_mask( sum, lim1 );
+                __mmask64 const ge2 = _mm512_cmpge_epu8_mask( sum, lim2 );
+                sum = _mm512_mask_sub_epi8( sum, ge1, sum, step );
+                sum = _mm512_mask_sub_epi8( sum, ge2, sum, step );
+                _mm512_store_si512( stat + col, sum );
+                curr = next;
+            }
+        }
+    }
+}
+
+template <CNosoHashKernel KERNEL>
+inline
+void CNosoHasherLanes<KERNEL>::_pack() {
+    NOSO_PROFILE_STAGE( CNosoStage::PACK, LANES );
+    for ( std::size_t lane = 0; lane < LANES; ++lane ) {
+        for ( std::size_t i = 0; i < 32; ++i ) {
+            m_hash[lane][i] = CNosoHasher::hex_dec2char_table[CNosoHasher::nosohash_chars_table[
+                    m_stat[4 * i + 0][lane] + m_stat[4 * i + 1][lane]
+                    + m_stat[4 * i + 2][lane] + m_stat[4 * i + 3][lane]] % 16];
+        }
+    }
+}
+
+template <CNosoHashKernel KERNEL>
+inline
+void CNosoHasherLanes<KERNEL>::_md5d() {
+    NOSO_PROFILE_STAGE( CNosoStage::MD5D, LANES );
+    if constexpr ( KERNEL == CNosoHashKernel::AVX512 ) {
+        static_assert( LANES % 16 == 0 );
+        for ( std::size_t lane = 0; lane < LANES; lane += 16 )
+            md5_32bytes_x16_avx512( (std::uint8_t const *)m_hash[lane], sizeof( m_hash[0] ), &m_digests[lane] );
+    } else {
+        static_assert( LANES % 8 == 0 );
+        for ( std::size_t lane = 0; lane < LANES; lane += 8 )
+            md5_32bytes_x8_avx2( (std::uint8_t const *)m_hash[lane], sizeof( m_hash[0] ), &m_digests[lane] );
+    }
+}
+
+template <CNosoHashKernel KERNEL>
+inline
+void CNosoHasherLanes<KERNEL>::_hexd( std::size_t lane, char hash[33] ) const {
+    for ( std::size_t i = 0; i < 16; ++i ) {
+        hash[2 * i + 0] = CNosoHasher::hex_dec2char_table[m_digests[lane][i] >>  4];
+        hash[2 * i + 1] = CNosoHasher::hex_dec2char_table[m_digests[lane][i] & 0xF];
+    }
+    hash[32] = '\0';
+}
+
+template <CNosoHashKernel KERNEL>
+char const * CNosoHasherLanes<KERNEL>::GetBase( std::uint32_t counter ) {
+    nosohash_itoa9( counter, m_base + 9 );
+    assert( std::strlen( m_base ) == 18 );
+    return m_base;
+}
+
+template <CNosoHashKernel KERNEL>
+inline
+void CNosoHasherLanes<KERNEL>::_hash( std::uint32_t counter ) {
+    this->_itoa( counter );
+    std::memcpy( m_stat, m_init, sizeof( m_init ) );
+    this->_stat();
+    this->_pack();
+    this->_md5d();
+}
+
+template <CNosoHashKernel KERNEL>
+char const ( * CNosoHasherLanes<KERNEL>::GetHashes( std::uint32_t counter ) )[33] {
+    this->_hash( counter );
+    for ( std::size_t lane = 0; lane < LANES; ++lane ) this->_hexd( lane, m_hash[lane] );
+    return m_hash;
+}
+
+template <CNosoHashKernel KERNEL>
+std::uint32_t CNosoHasherLanes<KERNEL>::HashRange( std::uint32_t counter_begin, std::uint32_t count,
+        CNosoHashTarget const & target, std::vector<CNosoHashHit> & out_hits ) {
+    std::uint32_t hashes_count { 0 };
+    for ( std::uint32_t done = 0; done < count; done += LANES ) {
+        this->_hash( counter_begin + done );
+        NOSO_PROFILE_STAGE( CNosoStage::CHECK, LANES );
+        // the lanes past the end of the range are hashed but not reported
+        std::uint32_t const lanes { std::min<std::uint32_t>( LANES, count - done ) };
+        for ( std::uint32_t lane = 0; lane < lanes; ++lane ) {
+            if ( target.Match( m_digests[lane] ) ) {
+                out_hits.push_back( { counter_begin + done + lane, "" } );
+                this->_hexd( lane, out_hits.back().hash );
+            }
+        }
+        hashes_count += lanes;
+    }
+    return hashes_count;
+}
+
+template <CNosoHashKernel KERNEL>
+std::uint32_t CNosoHasherLanes<KERNEL>::HashRange( std::uint32_t counter_begin, std::uint32_t count,
+        char const match_prefix[33], std::size_t match_len, std::vector<CNosoHashHit> & out_hits ) {
+    return this->HashRange( counter_begin, count, CNosoHashTarget { match_prefix, match_len }, out_hits );
+}
+
+template class CNosoHasherLanes<CNosoHashKernel::AVX2>;
+template class CNosoHasherLanes<CNosoHashKernel::AVX512>;
+#endif // NOSO_HASHING_X86
+
+struct nosohash_kernel_entry_t {
+    CNosoHashKernel kernel;
+    char const * name;
+    bool ( * supported )();
+};
+
+// The kernels from the fastest to the slowest, AUTO selects the first one
+// supported by the CPU
+constexpr static
+nosohash_kernel_entry_t const nosohash_kernel_registry[] {
+#ifdef NOSO_HASHING_X86
+    { CNosoHashKernel::AVX512, "avx512", &CNosoHasherAVX512::IsSupported },
+    { CNosoHashKernel::AVX2,   "avx2",   &CNosoHasherAVX2::IsSupported },
+#endif // NOSO_HASHING_X86
+    { CNosoHashKernel::SSE2,   "sse2",   []() { return CNosoHasher::IsSupported( CNosoStatKernel::SSE2 ); } },
+    { CNosoHashKernel::SCALAR, "scalar", []() { return CNosoHasher::IsSupported( CNosoStatKernel::SCALAR ); } },
+};
+
+char const * nosohash_kernel_name( CNosoHashKernel kernel ) {
+    for ( auto const & entry : nosohash_kernel_registry )
+        if ( entry.kernel == kernel ) return entry.name;
+    return kernel == CNosoHashKernel::AUTO ? "auto" : "unknown";
+}
+
+bool nosohash_kernel_from_name( std::string const & name, CNosoHashKernel & kernel ) {
+    if ( name == "auto" ) {
+        kernel = CNosoHashKernel::AUTO;
+        return true;
+    }
+    for ( auto const & entry : nosohash_kernel_registry ) {
+        if ( name == entry.name ) {
+            kernel = entry.kernel;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool nosohash_kernel_supported( CNosoHashKernel kernel ) {
+    for ( auto const & entry : nosohash_kernel_registry )
+        if ( entry.kernel == kernel ) return entry.supported();
+    return kernel == CNosoHashKernel::AUTO;
+}
+
+std::vector<CNosoHashKernel> nosohash_kernels_supported() {
+    std::vector<CNosoHashKernel> kernels;
+    for ( auto const & entry : nosohash_kernel_registry )
+        if ( entry.supported() ) kernels.push_back( entry.kernel );
+    return kernels;
+}
+
+CNosoHashKernel nosohash_kernel_select( CNosoHashKernel kernel ) {
+    if ( kernel != CNosoHashKernel::AUTO ) return kernel;
+    for ( auto const & entry : nosohash_kernel_registry )
+        if ( entry.supported() ) return entry.kernel;
+    return CNosoHashKernel::SCALAR;
+}
+
 constexpr static
 char const NOSOHASH_HASHEABLE_CHARS[] {
         "!\"#$%&')*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~" };
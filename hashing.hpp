@@ -7,18 +7,70 @@
 
 #include <cassert>
 #include <string>
+#include <vector>
 #include <algorithm>
 
-#include "md5-c.hpp"
+#include "md5-mb.hpp"
 
 #include "noso-2m.hpp"
 
+// Hashing kernels selectable with --hasher. SCALAR and SSE2 are the row
+// kernels of CNosoHasher hashing one nonce per call, AVX2 and AVX512 are the
+// batched CNosoHasherLanes. AUTO stands for the fastest one the CPU supports
+enum class CNosoHashKernel { AUTO, SCALAR, SSE2, AVX2, AVX512, };
+
+char const * nosohash_kernel_name( CNosoHashKernel kernel );
+bool nosohash_kernel_from_name( std::string const & name, CNosoHashKernel & kernel );
+bool nosohash_kernel_supported( CNosoHashKernel kernel );
+CNosoHashKernel nosohash_kernel_select( CNosoHashKernel kernel );
+std::vector<CNosoHashKernel> nosohash_kernels_supported();
+
+template <CNosoHashKernel KERNEL> class CNosoHasherLanes;
+
+// The first match_len hex chars of a target hash in the binary domain, as the
+// big-endian words of the MD5 digest bytes they encode. A digest starts with
+// the prefix when its words equal value under mask
+struct CNosoHashTarget {
+    std::uint64_t value[2];
+    std::uint64_t mask[2];
+    CNosoHashTarget( char const prefix[33], std::size_t match_len );
+    bool Match( std::uint8_t const digest[16] ) const {
+        std::uint64_t word0 { 0 }, word1 { 0 };
+        for ( std::size_t i = 0; i < 8; ++i ) word0 = ( word0 << 8 ) | digest[i];
+        if ( ( word0 & mask[0] ) != value[0] ) return false;
+        for ( std::size_t i = 8; i < 16; ++i ) word1 = ( word1 << 8 ) | digest[i];
+        return ( word1 & mask[1] ) == value[1];
+    }
+};
+
+// A nonce of HashRange whose hash starts with the requested prefix
+struct CNosoHashHit {
+    std::uint32_t counter;
+    char hash[33];
+};
+
+// Row kernels of CNosoHasher::_stat, each mixing step computes a whole row of
+// 128 columns as every column only reads the previous row's col and col + 1
+enum class CNosoStatKernel { SCALAR, SSE2, AVX2, };
+
 class CNosoHasher {
+    template <CNosoHashKernel KERNEL> friend class CNosoHasherLanes;
+    CNosoStatKernel m_stat_kernel { CNosoHasher::BestStatKernel() };
     char m_base[19];
     char m_hash[33];
     char m_diff[33];
     char m_stat[258];
-    MD5Context m_md5_ctx;
+    // Rows of _stat after each mixing step for the prefix and address given to
+    // Init. The columns not reached by the nonce columns 9..17 are the same for
+    // every nonce, so the kernels read them here instead of recomputing them
+    alignas( 32 ) std::uint8_t m_stat_cache[129][128];
+    std::uint8_t m_digest[16];
+#ifdef NOSO_HASHING_X86
+    // The packed hashes of 4 consecutive nonces digested together by
+    // HashRange when the row kernel is SIMD, and their digests
+    alignas( 16 ) char m_packs[4][32];
+    std::uint8_t m_digests[4][16];
+#endif // NOSO_HASHING_X86
     constexpr static char const hex_dec2char_table[] {
 '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F' };
     constexpr static char const hex_char2dec_table[] {
@@ -55,19 +107,78 @@ class CNosoHasher {
 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124,
     };
     void _init( char const prefix[10], char const address[32] );
+    void _cache();
     void _itoa( std::uint32_t n );
+    void _next();
     void _stat();
     void _pack();
     void _md5d();
+#ifdef NOSO_HASHING_X86
+    void _md5d_x4();
+#endif // NOSO_HASHING_X86
+    void _hexd( char hash[33] ) const;
     void _diff( char const target[33] );
 public:
+    constexpr static std::size_t const LANES { 1 };
     CNosoHasher() = default;
+    CNosoHasher( CNosoStatKernel stat_kernel );
+    static bool IsSupported( CNosoStatKernel stat_kernel );
+    static CNosoStatKernel BestStatKernel();
     void Init( char const prefix[10], char const address[32] );
     char const * GetBase( std::uint32_t counter );
     char const * GetHash();
+    char const ( * GetHashes( std::uint32_t counter ) )[33];
+    std::uint32_t HashRange( std::uint32_t counter_begin, std::uint32_t count,
+            CNosoHashTarget const & target, std::vector<CNosoHashHit> & out_hits );
+    std::uint32_t HashRange( std::uint32_t counter_begin, std::uint32_t count,
+            char const match_prefix[33], std::size_t match_len, std::vector<CNosoHashHit> & out_hits );
     char const * GetDiff( char const target[33] );
+    static void Diff( char const hash[33], char const target[33], char diff[33] );
 };
 
+#ifdef NOSO_HASHING_X86
+// Hashes LANES consecutive nonces per call. The stat matrices of all lanes are
+// kept transposed (one LANES-byte column per stat column) so that each mixing
+// step of _stat runs across all the lanes at once, 32 lanes with AVX2 and 64
+// with AVX-512BW, then _md5d digests the lanes with multi-buffer MD5. HashRange
+// compares the digests with the target and hex-encodes only the hits
+template <CNosoHashKernel KERNEL>
+class CNosoHasherLanes {
+    static_assert( KERNEL == CNosoHashKernel::AVX2 || KERNEL == CNosoHashKernel::AVX512 );
+public:
+    constexpr static std::size_t const LANES { KERNEL == CNosoHashKernel::AVX512 ? 64 : 32 };
+private:
+    alignas( 64 ) std::uint8_t m_init[128][LANES];
+    alignas( 64 ) std::uint8_t m_stat[129][LANES];
+    std::uint8_t m_stat_cache[129][128];
+    std::uint32_t m_counter;
+    std::size_t m_shared;
+    char m_base[19];
+    char m_hash[LANES][33];
+    std::uint8_t m_digests[LANES][16];
+    void _itoa( std::uint32_t counter );
+    void _cache();
+    void _stat();
+    void _pack();
+    void _md5d();
+    void _hexd( std::size_t lane, char hash[33] ) const;
+    void _hash( std::uint32_t counter );
+public:
+    CNosoHasherLanes() = default;
+    static bool IsSupported();
+    void Init( char const prefix[10], char const address[32] );
+    char const * GetBase( std::uint32_t counter );
+    char const ( * GetHashes( std::uint32_t counter ) )[33];
+    std::uint32_t HashRange( std::uint32_t counter_begin, std::uint32_t count,
+            CNosoHashTarget const & target, std::vector<CNosoHashHit> & out_hits );
+    std::uint32_t HashRange( std::uint32_t counter_begin, std::uint32_t count,
+            char const match_prefix[33], std::size_t match_len, std::vector<CNosoHashHit> & out_hits );
+};
+
+using CNosoHasherAVX2 = CNosoHasherLanes<CNosoHashKernel::AVX2>;
+using CNosoHasherAVX512 = CNosoHasherLanes<CNosoHashKernel::AVX512>;
+#endif // NOSO_HASHING_X86
+
 std::string nosohash_prefix( int num );
 
 #endif // __NOSO2M_HASHING__HPP__
@@ -2,24 +2,41 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include <chrono>
+#include <cerrno>
+#include <future>
+#include <functional>
 #include <cassert>
 #include <cstring>
+#include <algorithm>
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <iphlpapi.h>
 #else // LINUX/UNIX
+#include <poll.h>
 #include <netdb.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <ifaddrs.h>
 #include <net/if.h>
 #include <arpa/inet.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif // __linux__
 #endif // _WIN32
 
 #include "noso-2m.hpp"
 #include "inet.hpp"
 
+// no SIGPIPE from a pool closing the connection early where it can be asked
+#ifdef MSG_NOSIGNAL
+#define INET_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define INET_SEND_FLAGS 0
+#endif
+
 int inet_init() {
     #ifdef _WIN32
     WSADATA wsaData;
@@ -29,6 +46,7 @@ int inet_init() {
 }
 
 void inet_cleanup() {
+    inet_reactor().Stop();
     #ifdef _WIN32
     WSACleanup();
     #endif
@@ -63,9 +81,9 @@ struct addrinfo * inet_service( char const * host, char const * port ) {
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_protocol = IPPROTO_TCP;
     hints.ai_flags = AI_PASSIVE;
-    while ( 1 ) {
+    for ( int tries = 1; ; ++tries ) {
         int rc = getaddrinfo( host, port, &hints, &serv );
-        if ( rc == EAI_AGAIN ) {
+        if ( rc == EAI_AGAIN && tries < DEFAULT_INET_RESOLVE_RETRIES ) {
             continue;
         }
         else {
@@ -96,122 +114,477 @@ int inet_bind( int sockfd, struct addrinfo const * serv_info ) {
     return -1;
 }
 
+// the connect in progress or the send/recv which would block of a
+// non-blocking socket
 inline
-int inet_socket( int timeosec,
-        struct addrinfo const * serv_info,
-        struct addrinfo const * bind_serv ) {
-    assert( serv_info );
-    struct timeval timeout {
-        .tv_sec = timeosec,
-        .tv_usec = 0
-    };
-    int sockfd, rc;
-    fd_set rset, wset;
+bool inet_in_progress( bool connecting ) {
+    #ifdef _WIN32
+    (void)connecting;
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+    #else // LINUX/UNIX
+    if ( connecting ) return errno == EINPROGRESS;
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    #endif // END #ifdef _WIN32
+}
+
+enum class CInetState { CONNECTING, ARMED, SENDING, RECEIVING, };
+
+// A server address copied out of the addrinfo list it was resolved into, so
+// that it outlives the list
+struct CInetAddress {
+    int family;
+    int socktype;
+    int protocol;
+    socklen_t addrlen;
+    struct sockaddr_storage addr;
+};
+
+// The last known good addresses of a host and port. The refresh of stale ones
+// runs in the background, the exchanges go on with them meanwhile
+struct CInetResolved {
+    std::vector<CInetAddress> servs;
+    std::chrono::steady_clock::time_point expires;
+    std::future<void> refresh;
+};
+
+inline
+bool inet_resolve( std::string const & host, std::string const & port, std::vector<CInetAddress> & servs ) {
+    struct addrinfo * serv_info = inet_service( host.c_str(), port.c_str() );
+    if ( !serv_info ) return false;
+    servs.clear();
     for ( struct addrinfo const * psi = serv_info; psi != NULL; psi = psi->ai_next ) {
-        if ( (sockfd = socket( psi->ai_family, psi->ai_socktype,
-                               psi->ai_protocol ) ) == -1 ) {
-            continue;
+        if ( psi->ai_addrlen > sizeof( struct sockaddr_storage ) ) continue;
+        CInetAddress serv { psi->ai_family, psi->ai_socktype, psi->ai_protocol,
+                static_cast<socklen_t>( psi->ai_addrlen ), {} };
+        std::memcpy( &serv.addr, psi->ai_addr, psi->ai_addrlen );
+        servs.push_back( serv );
+    }
+    freeaddrinfo( serv_info );
+    return servs.size() > 0;
+}
+
+CInetResolver & inet_resolver() {
+    static CInetResolver resolver;
+    return resolver;
+}
+
+CInetResolver::~CInetResolver() {
+    // waiting for the refreshes in progress, which use the map
+    std::map<std::string, std::unique_ptr<CInetResolved>> resolved;
+    {
+        std::unique_lock<std::mutex> unique_lock_resolved( m_mutex_resolved );
+        resolved.swap( m_resolved );
+    }
+}
+
+// Fresh addresses are used as they are. Stale ones are used as well while
+// a refresh runs in the background, and kept when the resolver fails. Only a
+// host and port resolved for the first time waits for the resolver
+bool CInetResolver::Resolve( std::string const & host, std::string const & port,
+        std::vector<CInetAddress> & servs ) {
+    std::string const key { host + ":" + port };
+    {
+        std::unique_lock<std::mutex> unique_lock_resolved( m_mutex_resolved );
+        auto it { m_resolved.find( key ) };
+        if ( it != m_resolved.end() ) {
+            CInetResolved & resolved { *it->second };
+            bool const refreshing { resolved.refresh.valid()
+                    && resolved.refresh.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready };
+            if ( !refreshing && resolved.expires <= std::chrono::steady_clock::now() )
+                resolved.refresh = std::async( std::launch::async, &CInetResolver::_Refresh, this, host, port );
+            servs = resolved.servs;
+            return true;
         }
-        if ( bind_serv
-                && ( rc = inet_bind( sockfd, bind_serv ) ) == -1 ) {
-            inet_close_socket( sockfd );
-            continue;
+    }
+    std::vector<CInetAddress> resolved_servs;
+    if ( !inet_resolve( host, port, resolved_servs ) ) return false;
+    this->_Store( key, resolved_servs );
+    servs = resolved_servs;
+    return true;
+}
+
+// the addresses of host and port are refreshed at their next use, e.g. once
+// none of them can be connected to
+void CInetResolver::Expire( std::string const & host, std::string const & port ) {
+    std::unique_lock<std::mutex> unique_lock_resolved( m_mutex_resolved );
+    auto it { m_resolved.find( host + ":" + port ) };
+    if ( it != m_resolved.end() ) it->second->expires = std::chrono::steady_clock::now();
+}
+
+void CInetResolver::_Refresh( std::string host, std::string port ) {
+    std::vector<CInetAddress> servs;
+    if ( inet_resolve( host, port, servs ) ) {
+        this->_Store( host + ":" + port, servs );
+        return;
+    }
+    // the resolver is down, going on with the last known good addresses
+    std::unique_lock<std::mutex> unique_lock_resolved( m_mutex_resolved );
+    auto it { m_resolved.find( host + ":" + port ) };
+    if ( it != m_resolved.end() ) it->second->expires = std::chrono::steady_clock::now()
+        + std::chrono::seconds( DEFAULT_INET_RESOLVE_RETRYSEC );
+}
+
+void CInetResolver::_Store( std::string const & key, std::vector<CInetAddress> const & servs ) {
+    std::unique_lock<std::mutex> unique_lock_resolved( m_mutex_resolved );
+    auto & resolved { m_resolved[key] };
+    if ( !resolved ) resolved = std::make_unique<CInetResolved>();
+    resolved->servs = servs;
+    resolved->expires = std::chrono::steady_clock::now()
+        + std::chrono::seconds( DEFAULT_INET_RESOLVE_TTLSEC );
+}
+
+// A command sent to a server and its response received over a connection of
+// its own. The server addresses are tried in turn until one connects within
+// the timeout, then the send and the receive have the timeout each. A
+// connection made before send_time holds the command, armed, until then
+struct CInetExchange {
+    std::vector<CInetAddress> servs;
+    std::size_t serv_index { 0 };
+    struct addrinfo const * bind_serv;
+    int timeosec;
+    size_t command_msgsize;
+    char const * command_message;
+    size_t sent { 0 };
+    size_t response_buffsize;
+    char * response_buffer;
+    size_t received { 0 };
+    int sockfd { -1 };
+    CInetState state { CInetState::CONNECTING };
+    std::chrono::steady_clock::time_point send_time;
+    std::chrono::steady_clock::time_point deadline;
+    bool finished { false };
+    std::function<void( int )> done;
+    std::promise<int> result;
+};
+
+CInetReactor & inet_reactor() {
+    static CInetReactor reactor;
+    return reactor;
+}
+
+CInetReactor::~CInetReactor() {
+    this->Stop();
+}
+
+// The caller's buffers must outlive the exchange. The future gets what the
+// exchange has received, 0 on a send or receive timeout or a closed
+// connection before any response, -1 on errors. done, when given, is called
+// with the same result on the reactor thread just before the future gets it.
+// The command is sent no earlier than send_time, connected beforehand
+std::future<int> CInetReactor::Start( std::vector<CInetAddress> const & servs, struct addrinfo const * bind_serv,
+        int timeosec, size_t command_msgsize, char const * command_message,
+        size_t response_buffsize, char * response_buffer, std::function<void( int )> done,
+        std::chrono::steady_clock::time_point send_time ) {
+    assert( command_message && command_msgsize > 0
+           && response_buffer && response_buffsize > 0 );
+    auto exchange { std::make_unique<CInetExchange>() };
+    exchange->servs = servs;
+    exchange->bind_serv = bind_serv;
+    exchange->timeosec = timeosec;
+    exchange->command_msgsize = command_msgsize;
+    exchange->command_message = command_message;
+    exchange->response_buffsize = response_buffsize;
+    exchange->response_buffer = response_buffer;
+    exchange->response_buffer[0] = '\0';
+    exchange->done = std::move( done );
+    exchange->send_time = send_time;
+    std::future<int> result { exchange->result.get_future() };
+    {
+        std::unique_lock<std::mutex> unique_lock_pending( m_mutex_pending );
+        if ( !m_stopped && !m_thread.joinable() ) {
+    #ifdef __linux__
+            m_poll_fd = epoll_create1( EPOLL_CLOEXEC );
+            m_wake_fds[0] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+            struct epoll_event wake_event {};
+            wake_event.events = EPOLLIN;
+            wake_event.data.ptr = nullptr;
+            if ( m_poll_fd < 0 || m_wake_fds[0] < 0
+                    || epoll_ctl( m_poll_fd, EPOLL_CTL_ADD, m_wake_fds[0], &wake_event ) < 0 )
+                m_stopped = true;
+    #elif !defined( _WIN32 )
+            if ( pipe( m_wake_fds ) < 0
+                    || inet_set_nonblock( m_wake_fds[0] ) < 0
+                    || inet_set_nonblock( m_wake_fds[1] ) < 0 )
+                m_stopped = true;
+    #endif // __linux__
+            if ( !m_stopped ) m_thread = std::thread( &CInetReactor::_Run, this );
+        }
+        if ( m_stopped ) {
+            if ( exchange->done ) exchange->done( -1 );
+            exchange->result.set_value( -1 );
+            return result;
         }
-        if ( inet_set_nonblock( sockfd ) < 0 ) {
+        m_pending.push_back( std::move( exchange ) );
+    }
+    this->_Wake();
+    return result;
+}
+
+// finishes the exchanges left with -1, no exchange starts afterwards
+void CInetReactor::Stop() {
+    {
+        std::unique_lock<std::mutex> unique_lock_pending( m_mutex_pending );
+        m_stopped = true;
+    }
+    this->_Wake();
+    if ( m_thread.joinable() ) m_thread.join();
+    #ifdef __linux__
+    if ( m_poll_fd >= 0 ) close( m_poll_fd );
+    if ( m_wake_fds[0] >= 0 ) close( m_wake_fds[0] );
+    #elif !defined( _WIN32 )
+    if ( m_wake_fds[0] >= 0 ) close( m_wake_fds[0] );
+    if ( m_wake_fds[1] >= 0 ) close( m_wake_fds[1] );
+    #endif // __linux__
+    m_poll_fd = m_wake_fds[0] = m_wake_fds[1] = -1;
+}
+
+// wakes the reactor thread up to take the exchanges just started. Windows
+// can not poll a pipe with sockets, there the thread polls every
+// DEFAULT_INET_REACTOR_MSECS instead
+void CInetReactor::_Wake() {
+    #ifdef __linux__
+    std::uint64_t const one { 1 };
+    if ( m_wake_fds[0] >= 0 && write( m_wake_fds[0], &one, sizeof( one ) ) < 0 ) return;
+    #elif !defined( _WIN32 )
+    char const one { 1 };
+    if ( m_wake_fds[1] >= 0 && write( m_wake_fds[1], &one, sizeof( one ) ) < 0 ) return;
+    #endif // __linux__
+}
+
+// registers the socket of the exchange for the readiness its state waits for
+void CInetReactor::_Watch( CInetExchange & exchange, bool adding ) {
+    #ifdef __linux__
+    struct epoll_event event {};
+    event.events = exchange.state == CInetState::RECEIVING ? std::uint32_t( EPOLLIN )
+        : exchange.state == CInetState::ARMED ? 0 : std::uint32_t( EPOLLOUT );
+    event.data.ptr = &exchange;
+    epoll_ctl( m_poll_fd, adding ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, exchange.sockfd, &event );
+    #else // poll builds its set at every call
+    (void)exchange;
+    (void)adding;
+    #endif // __linux__
+}
+
+void CInetReactor::_Unwatch( CInetExchange & exchange ) {
+    #ifdef __linux__
+    struct epoll_event event {};
+    epoll_ctl( m_poll_fd, EPOLL_CTL_DEL, exchange.sockfd, &event );
+    #else // poll builds its set at every call
+    (void)exchange;
+    #endif // __linux__
+}
+
+// waits up to timeout_msecs for the sockets of the active exchanges, the
+// ready ones are added to ready
+void CInetReactor::_Poll( int timeout_msecs, std::vector<CInetExchange *> & ready ) {
+    #ifdef __linux__
+    struct epoll_event events[64];
+    int const n { epoll_wait( m_poll_fd, events, 64, timeout_msecs ) };
+    for ( int i = 0; i < n; ++i ) {
+        if ( events[i].data.ptr ) {
+            ready.push_back( static_cast<CInetExchange *>( events[i].data.ptr ) );
+        } else {
+            std::uint64_t count;
+            if ( read( m_wake_fds[0], &count, sizeof( count ) ) < 0 ) continue;
+        }
+    }
+    #else // poll, WSAPoll on Windows
+    std::vector<struct pollfd> fds;
+    std::vector<CInetExchange *> polled;
+    #ifndef _WIN32
+    fds.push_back( { m_wake_fds[0], POLLIN, 0 } );
+    polled.push_back( nullptr );
+    #else
+    timeout_msecs = std::min( timeout_msecs, DEFAULT_INET_REACTOR_MSECS );
+    #endif // _WIN32
+    for ( auto const & exchange : m_active ) {
+        if ( exchange->finished ) continue;
+        fds.push_back( { static_cast<decltype( pollfd::fd )>( exchange->sockfd ),
+                static_cast<short>( exchange->state == CInetState::RECEIVING ? POLLIN
+                        : exchange->state == CInetState::ARMED ? 0 : POLLOUT ), 0 } );
+        polled.push_back( exchange.get() );
+    }
+    #ifdef _WIN32
+    if ( fds.empty() ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( timeout_msecs ) );
+        return;
+    }
+    int const n { WSAPoll( fds.data(), static_cast<ULONG>( fds.size() ), timeout_msecs ) };
+    #else
+    int const n { poll( fds.data(), fds.size(), timeout_msecs ) };
+    #endif // _WIN32
+    for ( std::size_t i = 0; n > 0 && i < fds.size(); ++i ) {
+        if ( !fds[i].revents ) continue;
+        if ( polled[i] ) {
+            ready.push_back( polled[i] );
+        } else {
+            char drain[64];
+            while ( read( m_wake_fds[0], drain, sizeof( drain ) ) > 0 );
+        }
+    }
+    #endif // __linux__
+}
+
+// starts connecting to the next address of the exchange, finishes it with
+// -1 when none is left
+void CInetReactor::_Connect( CInetExchange & exchange ) {
+    for ( ; exchange.serv_index < exchange.servs.size(); ++exchange.serv_index ) {
+        CInetAddress const & serv { exchange.servs[exchange.serv_index] };
+        int sockfd = socket( serv.family, serv.socktype, serv.protocol );
+        if ( sockfd == -1 ) continue;
+        if ( ( exchange.bind_serv && inet_bind( sockfd, exchange.bind_serv ) == -1 )
+                || inet_set_nonblock( sockfd ) < 0 ) {
             inet_close_socket( sockfd );
             continue;
         }
-        if ( ( rc = connect( sockfd, psi->ai_addr, psi->ai_addrlen ) ) >= 0 ) {
-            return sockfd;
-        }
-        #ifdef _WIN32
-        if ( rc != SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK ) {
-        #else // LINUX/UNIX
-        if ( errno != EINPROGRESS ) {
-        #endif // END #ifdef _WIN32 ... #else // LINUX/UNIX
+        int rc = connect( sockfd, reinterpret_cast<struct sockaddr const *>( &serv.addr ), serv.addrlen );
+        if ( rc < 0 && !inet_in_progress( true ) ) {
             inet_close_socket( sockfd );
             continue;
         }
-        FD_ZERO( &rset );
-        FD_ZERO( &wset );
-        FD_SET( sockfd, &rset );
-        FD_SET( sockfd, &wset );
-        int n = select( sockfd + 1, &rset, &wset, NULL, &timeout );
-        if ( n <= 0 ) inet_close_socket( sockfd );
-        if ( FD_ISSET( sockfd, &rset ) || FD_ISSET( sockfd, &wset ) ) {
-            int error = 0;
-            socklen_t slen = sizeof( error );
-            if ( getsockopt( sockfd, SOL_SOCKET, SO_ERROR, (char *)&error, &slen ) < 0 ) {
-                inet_close_socket( sockfd );
-                continue;
-            }
-            if ( error ) {
-                inet_close_socket( sockfd );
-                continue;
-            }
+        exchange.sockfd = sockfd;
+        if ( rc < 0 ) {
+            exchange.state = CInetState::CONNECTING;
+            exchange.deadline = std::chrono::steady_clock::now() + std::chrono::seconds( exchange.timeosec );
+        } else {
+            this->_Connected( exchange );
         }
-        else continue;
-        return sockfd;
-    } // END for( ; psi != NULL; psi = psi->ai_next ) {
-    return -1;
+        this->_Watch( exchange, true );
+        return;
+    }
+    this->_Finish( exchange, -1 );
 }
 
-inline
-int inet_send( int sockfd, int timeosec, size_t msgsize, char const * message ) {
-    assert( message && msgsize > 0 );
-    struct timeval timeout {
-        .tv_sec = timeosec,
-        .tv_usec = 0
-    };
-    fd_set fds;
-    FD_ZERO( &fds );
-    FD_SET( sockfd, &fds );
-    int n = select( sockfd + 1, NULL, &fds, NULL, &timeout );
-    if ( n <= 0 ) return n; /* n == 0 timeout, n == -1 socket error */
-    int slen = send( sockfd, message, msgsize, 0 );
-    if ( slen <= 0 ) return slen; /* slen == 0 timeout, slen == -1 socket error */
-    return slen;
+// a connected exchange sends its command, or holds it until its send time
+void CInetReactor::_Connected( CInetExchange & exchange ) {
+    auto const now { std::chrono::steady_clock::now() };
+    if ( exchange.send_time > now ) {
+        exchange.state = CInetState::ARMED;
+        exchange.deadline = exchange.send_time;
+    } else {
+        exchange.state = CInetState::SENDING;
+        exchange.deadline = now + std::chrono::seconds( exchange.timeosec );
+    }
 }
 
-inline
-int inet_recv( int sockfd, int timeosec, size_t buffsize, char * buffer ) {
-    assert( buffer && buffsize > 0 );
-    struct timeval timeout {
-        .tv_sec = timeosec,
-        .tv_usec = 0
-    };
-    fd_set fds;
-    FD_ZERO( &fds );
-    FD_SET( sockfd, &fds );
-    int n = select( sockfd + 1, &fds, NULL, NULL, &timeout );
-    if ( n <= 0 ) return n; /* n == 0 timeout, n == -1 socket error */
-    int rlen = recv( sockfd, buffer, buffsize - 1, 0 );
-    if ( rlen <= 0 ) return rlen; /* rlen == 0 timeout, nlen == -1 socket error */
-    buffer[ rlen ] = '\0';
-    return rlen;
+// gives up the address the exchange is connecting to for the next one
+void CInetReactor::_Reconnect( CInetExchange & exchange ) {
+    this->_Unwatch( exchange );
+    inet_close_socket( exchange.sockfd );
+    exchange.sockfd = -1;
+    ++exchange.serv_index;
+    this->_Connect( exchange );
 }
 
-inline
-int inet_command( uint32_t timeosec,
-        size_t command_msgsize, char const * command_message,
-        size_t response_buffsize, char * response_buffer,
-        struct addrinfo const * serv_info,
-        struct addrinfo const * bind_serv ) {
-    assert( command_message && command_msgsize > 0
-           && response_buffer && response_buffsize > 0
-           && serv_info );
-    int sockfd = inet_socket( timeosec, serv_info, bind_serv );
-    if ( sockfd < 0 ) return sockfd;
-    int rlen = 0;
-    int slen = inet_send( sockfd, timeosec, command_msgsize, command_message );
-    if ( slen > 0 ) {
-        rlen = inet_recv( sockfd, timeosec, response_buffsize, response_buffer );
+// moves the exchange on once its socket is ready
+void CInetReactor::_Step( CInetExchange & exchange ) {
+    if ( exchange.state == CInetState::CONNECTING ) {
+        int error = 0;
+        socklen_t slen = sizeof( error );
+        if ( getsockopt( exchange.sockfd, SOL_SOCKET, SO_ERROR, (char *)&error, &slen ) < 0 || error ) {
+            this->_Reconnect( exchange );
+            return;
+        }
+        this->_Connected( exchange );
+        if ( exchange.state == CInetState::ARMED ) {
+            this->_Watch( exchange, false );
+            return;
+        }
+    }
+    if ( exchange.state == CInetState::ARMED ) {
+        // an armed connection is only reported when the server drops it
+        this->_Reconnect( exchange );
+        return;
+    }
+    if ( exchange.state == CInetState::SENDING ) {
+        int slen = send( exchange.sockfd, exchange.command_message + exchange.sent,
+                exchange.command_msgsize - exchange.sent, INET_SEND_FLAGS );
+        if ( slen < 0 ) {
+            if ( !inet_in_progress( false ) ) this->_Finish( exchange, -1 );
+            return;
+        }
+        exchange.sent += slen;
+        if ( exchange.sent < exchange.command_msgsize ) return;
+        exchange.state = CInetState::RECEIVING;
+        exchange.deadline = std::chrono::steady_clock::now() + std::chrono::seconds( exchange.timeosec );
+        this->_Watch( exchange, false );
+        return;
     }
-    inet_close_socket( sockfd );
-    if ( slen <= 0 ) {
-        return slen;
+    // the response ends with its line, the connection or the buffer
+    char * const chunk { exchange.response_buffer + exchange.received };
+    int rlen = recv( exchange.sockfd, chunk, exchange.response_buffsize - 1 - exchange.received, 0 );
+    if ( rlen < 0 ) {
+        if ( !inet_in_progress( false ) )
+            this->_Finish( exchange, exchange.received > 0 ? int( exchange.received ) : -1 );
+        return;
     }
-    return rlen;
+    exchange.received += rlen;
+    exchange.response_buffer[exchange.received] = '\0';
+    if ( rlen == 0 || std::memchr( chunk, '\n', rlen ) || exchange.received + 1 >= exchange.response_buffsize )
+        this->_Finish( exchange, int( exchange.received ) );
+}
+
+// a connect timing out goes on with the next address, a send or a receive
+// timing out finishes the exchange with what it has received. An armed
+// exchange is due to send its command
+void CInetReactor::_Expire( CInetExchange & exchange ) {
+    if ( exchange.state == CInetState::ARMED ) {
+        exchange.state = CInetState::SENDING;
+        exchange.deadline = std::chrono::steady_clock::now() + std::chrono::seconds( exchange.timeosec );
+        this->_Watch( exchange, false );
+        this->_Step( exchange );
+    }
+    else if ( exchange.state == CInetState::CONNECTING ) this->_Reconnect( exchange );
+    else this->_Finish( exchange, int( exchange.received ) );
+}
+
+void CInetReactor::_Finish( CInetExchange & exchange, int result ) {
+    if ( exchange.sockfd >= 0 ) {
+        this->_Unwatch( exchange );
+        inet_close_socket( exchange.sockfd );
+        exchange.sockfd = -1;
+    }
+    exchange.finished = true;
+    if ( exchange.done ) exchange.done( result );
+    exchange.result.set_value( result );
+}
+
+void CInetReactor::_Run() {
+    std::vector<CInetExchange *> ready;
+    for ( ;; ) {
+        std::size_t started { m_active.size() };
+        {
+            std::unique_lock<std::mutex> unique_lock_pending( m_mutex_pending );
+            if ( m_stopped ) {
+                for ( auto & exchange : m_pending ) m_active.push_back( std::move( exchange ) );
+                m_pending.clear();
+                break;
+            }
+            for ( auto & exchange : m_pending ) m_active.push_back( std::move( exchange ) );
+            m_pending.clear();
+        }
+        for ( ; started < m_active.size(); ++started ) this->_Connect( *m_active[started] );
+        // waiting no longer than the nearest deadline
+        auto now { std::chrono::steady_clock::now() };
+        std::int64_t timeout_msecs { 1'000 };
+        for ( auto const & exchange : m_active ) {
+            if ( exchange->finished ) continue;
+            timeout_msecs = std::min<std::int64_t>( timeout_msecs, std::max<std::int64_t>( 0,
+                    std::chrono::ceil<std::chrono::milliseconds>( exchange->deadline - now ).count() ) );
+        }
+        ready.clear();
+        this->_Poll( static_cast<int>( timeout_msecs ), ready );
+        for ( auto exchange : ready )
+            if ( !exchange->finished ) this->_Step( *exchange );
+        now = std::chrono::steady_clock::now();
+        for ( auto const & exchange : m_active )
+            if ( !exchange->finished && exchange->deadline <= now ) this->_Expire( *exchange );
+        m_active.erase( std::remove_if( m_active.begin(), m_active.end(),
+                []( auto const & exchange ) { return exchange->finished; } ), m_active.end() );
+    }
+    for ( auto const & exchange : m_active )
+        if ( !exchange->finished ) this->_Finish( *exchange, -1 );
+    m_active.clear();
 }
 
 int inet_local_ipv4( char const ipv4_addr[] ) {
@@ -280,23 +653,41 @@ CInet::CInet( std::string const & host, std::string const & port, int timeosec )
     :   m_host { host }, m_port { port }, m_timeosec( timeosec ) {
 }
 
-inline
-int CInet::ExecCommand(
+// Starts the command without waiting for its response, done is called once
+// the result is known, just before the future gets it
+std::future<int> CInet::StartCommand(
         size_t command_msgsize, char const * command_message,
         size_t response_buffsize, char * response_buffer,
-        struct addrinfo const * bind_serv ) {
+        struct addrinfo const * bind_serv, std::function<void()> done,
+        std::chrono::steady_clock::time_point send_time ) {
     assert( command_message && command_msgsize > 0
            && response_buffer && response_buffsize > 0 );
-    struct addrinfo * serv_info = inet_service( m_host.c_str(), m_port.c_str() );
-    if ( !serv_info ) {
-        return -1;
+    std::vector<CInetAddress> servs;
+    if ( !inet_resolver().Resolve( m_host, m_port, servs ) ) {
+        std::promise<int> result;
+        if ( done ) done();
+        result.set_value( -1 );
+        return result.get_future();
     }
-    int n = inet_command( m_timeosec,
+    return inet_reactor().Start( servs, bind_serv, m_timeosec,
             command_msgsize, command_message,
             response_buffsize, response_buffer,
-            serv_info, bind_serv );
-    freeaddrinfo( serv_info );
-    return n;
+            [host = m_host, port = m_port, done = std::move( done )]( int n ) {
+                if ( n < 0 ) inet_resolver().Expire( host, port );
+                if ( done ) done();
+            }, send_time );
+}
+
+// Starts the command and waits for its response, up to the timeout
+inline
+int CInet::ExecCommand(
+        size_t command_msgsize, char const * command_message,
+        size_t response_buffsize, char * response_buffer,
+        struct addrinfo const * bind_serv ) {
+    return this->StartCommand(
+            command_msgsize, command_message,
+            response_buffsize, response_buffer,
+            bind_serv ).get();
 }
 
 CPoolInet::CPoolInet( const std::string& name, const std::string &host, const std::string &port,
@@ -352,6 +743,22 @@ void CPoolInet::BuildCommandRequestSource( const char address[32],
             "SOURCE %s noso-2m-v%s\n", address, NOSO_2M_VERSION );
 }
 
+// connects at once and sends SOURCE at send_time, see StartCommand
+std::future<int> CPoolInet::StartRequestSource( const char address[32],
+        size_t command_msgsize, char * command_message,
+        size_t response_buffsize, char * response_buffer,
+        std::function<void()> done, std::chrono::steady_clock::time_point send_time ) {
+    assert( std::strlen( address ) == 30 || std::strlen( address ) == 31 );
+    assert( command_message && command_msgsize > 0
+           && response_buffer && response_buffsize > 0 );
+    this->BuildCommandRequestSource( address,
+            command_msgsize, command_message );
+    return this->StartCommand(
+            command_msgsize, command_message,
+            response_buffsize, response_buffer,
+            m_bind_serv, std::move( done ), send_time );
+}
+
 int CPoolInet::RequestSource( const char address[32],
         size_t command_msgsize, char * command_message,
         size_t response_buffsize, char * response_buffer ) {
@@ -393,3 +800,20 @@ int CPoolInet::SubmitSolution( std::uint32_t blck_no,
             m_bind_serv );
 }
 
+std::future<int> CPoolInet::StartSubmitSolution( std::uint32_t blck_no,
+        const char base[19], const char address[32],
+        size_t command_msgsize, char * command_message,
+        size_t response_buffsize, char * response_buffer,
+        std::function<void()> done ) {
+    assert( std::strlen( base ) == 18
+            && ( std::strlen( address ) == 30 || std::strlen( address ) == 31 ) );
+    assert( command_message && command_msgsize > 0
+           && response_buffer && response_buffsize > 0 );
+    this->BuildCommandSubmitSolution( blck_no, base, address,
+            command_msgsize, command_message );
+    return this->StartCommand(
+            command_msgsize, command_message,
+            response_buffsize, response_buffer,
+            m_bind_serv, std::move( done ) );
+}
+
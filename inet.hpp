@@ -5,13 +5,92 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include <map>
+#include <mutex>
+#include <chrono>
 #include <string>
+#include <memory>
+#include <thread>
+#include <future>
+#include <vector>
+#include <cstdint>
+#include <functional>
 
 int inet_init();
 void inet_cleanup();
 struct addrinfo * inet_service( char const * host, char const * port );
 int inet_local_ipv4( char const ipv4_addr[] );
 
+struct CInetAddress;
+struct CInetResolved;
+struct CInetExchange;
+
+// The addresses of the pools, resolved once and then refreshed every
+// DEFAULT_INET_RESOLVE_TTLSEC, shared by all the commands to a pool
+// instead of a getaddrinfo before each one
+class CInetResolver {
+    std::mutex m_mutex_resolved;
+    std::map<std::string, std::unique_ptr<CInetResolved>> m_resolved;
+    void _Refresh( std::string host, std::string port );
+    void _Store( std::string const & key, std::vector<CInetAddress> const & servs );
+public:
+    CInetResolver() = default;
+    ~CInetResolver();
+    CInetResolver( const CInetResolver& ) = delete; // Copy prohibited
+    CInetResolver( CInetResolver&& ) = delete; // Move prohibited
+    void operator=( const CInetResolver& ) = delete; // Assignment prohibited
+    CInetResolver& operator=( CInetResolver&& ) = delete; // Move assignment prohibited
+    bool Resolve( std::string const & host, std::string const & port, std::vector<CInetAddress> & servs );
+    void Expire( std::string const & host, std::string const & port );
+};
+
+CInetResolver & inet_resolver();
+
+// One thread running the exchanges with all the pools, each a command sent
+// and its response received over a connection of its own, as non-blocking
+// state machines: connecting, sending then receiving. A slow pool holds no
+// reactor time, only its own sockets, but a caller of CInet::ExecCommand
+// waits for its exchange: the comm thread of a slow pool is held by it up
+// to the timeout, the ones of the other pools are not. epoll drives the
+// sockets on Linux, poll on the other systems and WSAPoll on Windows.
+// Started by the first exchange
+class CInetReactor {
+    std::mutex m_mutex_pending;
+    std::vector<std::unique_ptr<CInetExchange>> m_pending;
+    bool m_stopped { false };
+    // of the reactor thread only
+    std::vector<std::unique_ptr<CInetExchange>> m_active;
+    std::thread m_thread;
+    int m_poll_fd { -1 };
+    int m_wake_fds[2] { -1, -1 };
+    void _Run();
+    void _Wake();
+    void _Watch( CInetExchange & exchange, bool adding );
+    void _Unwatch( CInetExchange & exchange );
+    void _Poll( int timeout_msecs, std::vector<CInetExchange *> & ready );
+    void _Connect( CInetExchange & exchange );
+    void _Connected( CInetExchange & exchange );
+    void _Reconnect( CInetExchange & exchange );
+    void _Step( CInetExchange & exchange );
+    void _Expire( CInetExchange & exchange );
+    void _Finish( CInetExchange & exchange, int result );
+public:
+    CInetReactor() = default;
+    ~CInetReactor();
+    CInetReactor( const CInetReactor& ) = delete; // Copy prohibited
+    CInetReactor( CInetReactor&& ) = delete; // Move prohibited
+    void operator=( const CInetReactor& ) = delete; // Assignment prohibited
+    CInetReactor& operator=( CInetReactor&& ) = delete; // Move assignment prohibited
+    std::future<int> Start( std::vector<CInetAddress> const & servs, struct addrinfo const * bind_serv,
+            int timeosec, size_t command_msgsize, char const * command_message,
+            size_t response_buffsize, char * response_buffer,
+            std::function<void( int )> done = nullptr,
+            std::chrono::steady_clock::time_point send_time = {} );
+    void Stop();
+};
+
+CInetReactor & inet_reactor();
+
 class CInet {
 public:
     std::string const & m_host;
@@ -19,6 +98,11 @@ public:
     const int m_timeosec;
 public:
     CInet( std::string const & host, std::string const & port, int timeosec );
+    std::future<int> StartCommand(
+            size_t command_msgsize, char const * command_message,
+            size_t response_buffsize, char * response_buffer,
+            struct addrinfo const * bind_serv=nullptr, std::function<void()> done=nullptr,
+            std::chrono::steady_clock::time_point send_time={} );
     int ExecCommand(
             size_t command_msgsize, char const * command_message,
             size_t response_buffsize, char * response_buffer,
@@ -48,6 +132,10 @@ public:
     int RequestSource( const char address[32],
             size_t command_msgsize, char * command_message,
             size_t response_buffsize, char * response_buffer );
+    std::future<int> StartRequestSource( const char address[32],
+            size_t command_msgsize, char * command_message,
+            size_t response_buffsize, char * response_buffer,
+            std::function<void()> done, std::chrono::steady_clock::time_point send_time );
     void BuildCommandSubmitSolution( std::uint32_t blck_no,
             const char base[19], const char address[32],
             size_t command_msgsize, char * command_message );
@@ -55,6 +143,11 @@ public:
             const char base[19], const char address[32],
             size_t command_msgsize, char * command_message,
             size_t response_buffsize, char * response_buffer );
+    std::future<int> StartSubmitSolution( std::uint32_t blck_no,
+            const char base[19], const char address[32],
+            size_t command_msgsize, char * command_message,
+            size_t response_buffsize, char * response_buffer,
+            std::function<void()> done=nullptr );
 };
 
 #endif // __NOSO2M_INET_HPP__
@@ -0,0 +1,273 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <cstring>
+
+#include "md5-mb.hpp"
+
+#ifdef NOSO_HASHING_X86
+#include <immintrin.h>
+#endif // NOSO_HASHING_X86
+
+constexpr static std::uint32_t const md5mb_iv[4] {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476,
+};
+constexpr static std::uint32_t const md5mb_k[64] {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+// Message word used by each step
+constexpr static int const md5mb_g[64] {
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+     1,  6, 11,  0,  5, 10, 15,  4,  9, 14,  3,  8, 13,  2,  7, 12,
+     5,  8, 11, 14,  1,  4,  7, 10, 13,  0,  3,  6,  9, 12, 15,  2,
+     0,  7, 14,  5, 12,  3, 10,  1,  8, 15,  6, 13,  4, 11,  2,  9
+};
+
+// Words 8..15 of the single block of a 32-byte message: the 0x80 terminator,
+// zeros and the message length in bits
+constexpr inline std::uint32_t md5mb_pad_word( int g ) {
+    return g == 8 ? 0x00000080u : g == 14 ? 32u * 8u : 0u;
+}
+// Additive constant of a step, with the padding word folded in when the step
+// reads one
+constexpr inline std::uint32_t md5mb_step_k( int i ) {
+    return md5mb_g[i] < 8 ? md5mb_k[i] : md5mb_k[i] + md5mb_pad_word( md5mb_g[i] );
+}
+
+// The 64 steps, fully unrolled so that the message word, constant and shift
+// count of each step are compile-time constants, the shift counts are spelled
+// out as immediates as not every compiler folds a table lookup into one
+#define MD5MB_ROUNDS( STEP ) \
+    STEP( F, a, b, c, d,  0,  7 ) \
+    STEP( F, d, a, b, c,  1, 12 ) \
+    STEP( F, c, d, a, b,  2, 17 ) \
+    STEP( F, b, c, d, a,  3, 22 ) \
+    STEP( F, a, b, c, d,  4,  7 ) \
+    STEP( F, d, a, b, c,  5, 12 ) \
+    STEP( F, c, d, a, b,  6, 17 ) \
+    STEP( F, b, c, d, a,  7, 22 ) \
+    STEP( F, a, b, c, d,  8,  7 ) \
+    STEP( F, d, a, b, c,  9, 12 ) \
+    STEP( F, c, d, a, b, 10, 17 ) \
+    STEP( F, b, c, d, a, 11, 22 ) \
+    STEP( F, a, b, c, d, 12,  7 ) \
+    STEP( F, d, a, b, c, 13, 12 ) \
+    STEP( F, c, d, a, b, 14, 17 ) \
+    STEP( F, b, c, d, a, 15, 22 ) \
+    STEP( G, a, b, c, d, 16,  5 ) \
+    STEP( G, d, a, b, c, 17,  9 ) \
+    STEP( G, c, d, a, b, 18, 14 ) \
+    STEP( G, b, c, d, a, 19, 20 ) \
+    STEP( G, a, b, c, d, 20,  5 ) \
+    STEP( G, d, a, b, c, 21,  9 ) \
+    STEP( G, c, d, a, b, 22, 14 ) \
+    STEP( G, b, c, d, a, 23, 20 ) \
+    STEP( G, a, b, c, d, 24,  5 ) \
+    STEP( G, d, a, b, c, 25,  9 ) \
+    STEP( G, c, d, a, b, 26, 14 ) \
+    STEP( G, b, c, d, a, 27, 20 ) \
+    STEP( G, a, b, c, d, 28,  5 ) \
+    STEP( G, d, a, b, c, 29,  9 ) \
+    STEP( G, c, d, a, b, 30, 14 ) \
+    STEP( G, b, c, d, a, 31, 20 ) \
+    STEP( H, a, b, c, d, 32,  4 ) \
+    STEP( H, d, a, b, c, 33, 11 ) \
+    STEP( H, c, d, a, b, 34, 16 ) \
+    STEP( H, b, c, d, a, 35, 23 ) \
+    STEP( H, a, b, c, d, 36,  4 ) \
+    STEP( H, d, a, b, c, 37, 11 ) \
+    STEP( H, c, d, a, b, 38, 16 ) \
+    STEP( H, b, c, d, a, 39, 23 ) \
+    STEP( H, a, b, c, d, 40,  4 ) \
+    STEP( H, d, a, b, c, 41, 11 ) \
+    STEP( H, c, d, a, b, 42, 16 ) \
+    STEP( H, b, c, d, a, 43, 23 ) \
+    STEP( H, a, b, c, d, 44,  4 ) \
+    STEP( H, d, a, b, c, 45, 11 ) \
+    STEP( H, c, d, a, b, 46, 16 ) \
+    STEP( H, b, c, d, a, 47, 23 ) \
+    STEP( I, a, b, c, d, 48,  6 ) \
+    STEP( I, d, a, b, c, 49, 10 ) \
+    STEP( I, c, d, a, b, 50, 15 ) \
+    STEP( I, b, c, d, a, 51, 21 ) \
+    STEP( I, a, b, c, d, 52,  6 ) \
+    STEP( I, d, a, b, c, 53, 10 ) \
+    STEP( I, c, d, a, b, 54, 15 ) \
+    STEP( I, b, c, d, a, 55, 21 ) \
+    STEP( I, a, b, c, d, 56,  6 ) \
+    STEP( I, d, a, b, c, 57, 10 ) \
+    STEP( I, c, d, a, b, 58, 15 ) \
+    STEP( I, b, c, d, a, 59, 21 ) \
+    STEP( I, a, b, c, d, 60,  6 ) \
+    STEP( I, d, a, b, c, 61, 10 ) \
+    STEP( I, c, d, a, b, 62, 15 ) \
+    STEP( I, b, c, d, a, 63, 21 )
+
+// One step of each variant, built from its ADD, ROTL, SET1 and F/G/H/I
+#define MD5MB_STEP( FN, a, b, c, d, i, s ) \
+    a = ADD( b, ROTL( ADD( ADD( a, FN( b, c, d ) ), md5mb_g[i] < 8 \
+        ? ADD( m[md5mb_g[i] & 7], SET1( md5mb_step_k( i ) ) ) \
+        : SET1( md5mb_step_k( i ) ) ), s ) );
+
+inline std::uint32_t md5mb_load32( std::uint8_t const * p ) {
+    return    (std::uint32_t)p[0]         | ( (std::uint32_t)p[1] <<  8 )
+           | ( (std::uint32_t)p[2] << 16 ) | ( (std::uint32_t)p[3] << 24 );
+}
+inline void md5mb_store32( std::uint8_t * p, std::uint32_t v ) {
+    p[0] = (std::uint8_t)( v       );
+    p[1] = (std::uint8_t)( v >>  8 );
+    p[2] = (std::uint8_t)( v >> 16 );
+    p[3] = (std::uint8_t)( v >> 24 );
+}
+// Adds the initial state to the final state of each lane and writes out the
+// lanes' digests
+inline void md5mb_digests( std::size_t lanes, std::uint32_t const * a, std::uint32_t const * b,
+                          std::uint32_t const * c, std::uint32_t const * d, std::uint8_t digests[][16] ) {
+    for ( std::size_t lane = 0; lane < lanes; ++lane ) {
+        md5mb_store32( &digests[lane][ 0], a[lane] + md5mb_iv[0] );
+        md5mb_store32( &digests[lane][ 4], b[lane] + md5mb_iv[1] );
+        md5mb_store32( &digests[lane][ 8], c[lane] + md5mb_iv[2] );
+        md5mb_store32( &digests[lane][12], d[lane] + md5mb_iv[3] );
+    }
+}
+
+void md5_32bytes_x1( std::uint8_t const * message, std::uint8_t digest[16] ) {
+    #define ADD( x, y ) ( (std::uint32_t)( ( x ) + ( y ) ) )
+    #define ROTL( x, s ) ( ( ( x ) << ( s ) ) | ( ( x ) >> ( 32 - ( s ) ) ) )
+    #define SET1( x ) ( (std::uint32_t)( x ) )
+    #define F( x, y, z ) ( ( z ) ^ ( ( x ) & ( ( y ) ^ ( z ) ) ) )
+    #define G( x, y, z ) ( ( y ) ^ ( ( z ) & ( ( x ) ^ ( y ) ) ) )
+    #define H( x, y, z ) ( ( x ) ^ ( y ) ^ ( z ) )
+    #define I( x, y, z ) ( ( y ) ^ ( ( x ) | ~( z ) ) )
+    std::uint32_t m[8];
+    for ( int j = 0; j < 8; ++j ) m[j] = md5mb_load32( message + 4 * j );
+    std::uint32_t a { md5mb_iv[0] }, b { md5mb_iv[1] }, c { md5mb_iv[2] }, d { md5mb_iv[3] };
+    MD5MB_ROUNDS( MD5MB_STEP )
+    md5mb_digests( 1, &a, &b, &c, &d, (std::uint8_t (*)[16])digest );
+    #undef ADD
+    #undef ROTL
+    #undef SET1
+    #undef F
+    #undef G
+    #undef H
+    #undef I
+}
+
+#ifdef NOSO_HASHING_X86
+__attribute__(( target( "sse2" ) ))
+void md5_32bytes_x4_sse2( std::uint8_t const * messages, std::size_t stride, std::uint8_t digests[][16] ) {
+    #define ADD( x, y ) _mm_add_epi32( x, y )
+    #define ROTL( x, s ) _mm_or_si128( _mm_slli_epi32( x, s ), _mm_srli_epi32( x, 32 - ( s ) ) )
+    #define SET1( x ) _mm_set1_epi32( (int)( x ) )
+    #define F( x, y, z ) _mm_xor_si128( z, _mm_and_si128( x, _mm_xor_si128( y, z ) ) )
+    #define G( x, y, z ) _mm_xor_si128( y, _mm_and_si128( z, _mm_xor_si128( x, y ) ) )
+    #define H( x, y, z ) _mm_xor_si128( _mm_xor_si128( x, y ), z )
+    #define I( x, y, z ) _mm_xor_si128( y, _mm_or_si128( x, _mm_xor_si128( z, _mm_set1_epi32( -1 ) ) ) )
+    __m128i m[8];
+    for ( int j = 0; j < 8; ++j ) {
+        std::uint8_t const * p = messages + 4 * j;
+        m[j] = _mm_setr_epi32( (int)md5mb_load32( p ), (int)md5mb_load32( p + stride ),
+                               (int)md5mb_load32( p + 2 * stride ), (int)md5mb_load32( p + 3 * stride ) );
+    }
+    __m128i a { SET1( md5mb_iv[0] ) }, b { SET1( md5mb_iv[1] ) };
+    __m128i c { SET1( md5mb_iv[2] ) }, d { SET1( md5mb_iv[3] ) };
+    MD5MB_ROUNDS( MD5MB_STEP )
+    alignas( 16 ) std::uint32_t va[4], vb[4], vc[4], vd[4];
+    _mm_store_si128( (__m128i *)va, a );
+    _mm_store_si128( (__m128i *)vb, b );
+    _mm_store_si128( (__m128i *)vc, c );
+    _mm_store_si128( (__m128i *)vd, d );
+    md5mb_digests( 4, va, vb, vc, vd, digests );
+    #undef ADD
+    #undef ROTL
+    #undef SET1
+    #undef F
+    #undef G
+    #undef H
+    #undef I
+}
+
+__attribute__(( target( "avx2" ) ))
+void md5_32bytes_x8_avx2( std::uint8_t const * messages, std::size_t stride, std::uint8_t digests[][16] ) {
+    #define ADD( x, y ) _mm256_add_epi32( x, y )
+    #define ROTL( x, s ) _mm256_or_si256( _mm256_slli_epi32( x, s ), _mm256_srli_epi32( x, 32 - ( s ) ) )
+    #define SET1( x ) _mm256_set1_epi32( (int)( x ) )
+    #define F( x, y, z ) _mm256_xor_si256( z, _mm256_and_si256( x, _mm256_xor_si256( y, z ) ) )
+    #define G( x, y, z ) _mm256_xor_si256( y, _mm256_and_si256( z, _mm256_xor_si256( x, y ) ) )
+    #define H( x, y, z ) _mm256_xor_si256( _mm256_xor_si256( x, y ), z )
+    #define I( x, y, z ) _mm256_xor_si256( y, _mm256_or_si256( x, _mm256_xor_si256( z, _mm256_set1_epi32( -1 ) ) ) )
+    __m256i const index { _mm256_mullo_epi32( _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ),
+                                                _mm256_set1_epi32( (int)stride ) ) };
+    __m256i m[8];
+    for ( int j = 0; j < 8; ++j )
+        m[j] = _mm256_i32gather_epi32( (int const *)( messages + 4 * j ), index, 1 );
+    __m256i a { SET1( md5mb_iv[0] ) }, b { SET1( md5mb_iv[1] ) };
+    __m256i c { SET1( md5mb_iv[2] ) }, d { SET1( md5mb_iv[3] ) };
+    MD5MB_ROUNDS( MD5MB_STEP )
+    alignas( 32 ) std::uint32_t va[8], vb[8], vc[8], vd[8];
+    _mm256_store_si256( (__m256i *)va, a );
+    _mm256_store_si256( (__m256i *)vb, b );
+    _mm256_store_si256( (__m256i *)vc, c );
+    _mm256_store_si256( (__m256i *)vd, d );
+    md5mb_digests( 8, va, vb, vc, vd, digests );
+    #undef ADD
+    #undef ROTL
+    #undef SET1
+    #undef F
+    #undef G
+    #undef H
+    #undef I
+}
+
+__attribute__(( target( "avx512f" ) ))
+void md5_32bytes_x16_avx512( std::uint8_t const * messages, std::size_t stride, std::uint8_t digests[][16] ) {
+    // F, G, H and I as single ternary-logic instructions, the immediates are
+    // the truth tables of the functions over ( x, y, z ) = ( 0xF0, 0xCC, 0xAA ),
+    // full-mask forms of rol and gather keep GCC from warning on the
+    // undefined pass-through register of the unmasked ones
+    #define ADD( x, y ) _mm512_add_epi32( x, y )
+    #define ROTL( x, s ) _mm512_maskz_rol_epi32( 0xFFFF, x, s )
+    #define SET1( x ) _mm512_set1_epi32( (int)( x ) )
+    #define F( x, y, z ) _mm512_ternarylogic_epi32( x, y, z, 0xCA )
+    #define G( x, y, z ) _mm512_ternarylogic_epi32( x, y, z, 0xE4 )
+    #define H( x, y, z ) _mm512_ternarylogic_epi32( x, y, z, 0x96 )
+    #define I( x, y, z ) _mm512_ternarylogic_epi32( x, y, z, 0x39 )
+    __m512i const index { _mm512_mullo_epi32( _mm512_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 ),
+                                                _mm512_set1_epi32( (int)stride ) ) };
+    __m512i m[8];
+    for ( int j = 0; j < 8; ++j )
+        m[j] = _mm512_mask_i32gather_epi32( _mm512_setzero_si512(), 0xFFFF, index, (void const *)( messages + 4 * j ), 1 );
+    __m512i a { SET1( md5mb_iv[0] ) }, b { SET1( md5mb_iv[1] ) };
+    __m512i c { SET1( md5mb_iv[2] ) }, d { SET1( md5mb_iv[3] ) };
+    MD5MB_ROUNDS( MD5MB_STEP )
+    alignas( 64 ) std::uint32_t va[16], vb[16], vc[16], vd[16];
+    _mm512_store_si512( (void *)va, a );
+    _mm512_store_si512( (void *)vb, b );
+    _mm512_store_si512( (void *)vc, c );
+    _mm512_store_si512( (void *)vd, d );
+    md5mb_digests( 16, va, vb, vc, vd, digests );
+    #undef ADD
+    #undef ROTL
+    #undef SET1
+    #undef F
+    #undef G
+    #undef H
+    #undef I
+}
+#endif // NOSO_HASHING_X86
@@ -0,0 +1,28 @@
+#ifndef __NOSO2M_MD5_MB_HPP__
+#define __NOSO2M_MD5_MB_HPP__
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <cstdint>
+#include <cstddef>
+
+#include "noso-2m.hpp"
+
+// Multi-buffer MD5 of 32-byte messages, the only message length NosoHash ever
+// digests. A 32-byte message always fits in a single 64-byte block whose
+// padding words (0x80 terminator, zeros and the 256-bit length) are constants,
+// so they are folded into the per-step additive constants at compile time and
+// only the 8 message words are loaded per lane.
+//
+// Lane i reads its message at messages + i * stride and gets its 16-byte
+// digest written to digests[i].
+void md5_32bytes_x1( std::uint8_t const * message, std::uint8_t digest[16] );
+#ifdef NOSO_HASHING_X86
+void md5_32bytes_x4_sse2( std::uint8_t const * messages, std::size_t stride, std::uint8_t digests[][16] );
+void md5_32bytes_x8_avx2( std::uint8_t const * messages, std::size_t stride, std::uint8_t digests[][16] );
+void md5_32bytes_x16_avx512( std::uint8_t const * messages, std::size_t stride, std::uint8_t digests[][16] );
+#endif // NOSO_HASHING_X86
+
+#endif // __NOSO2M_MD5_MB_HPP__
@@ -5,129 +5,456 @@
 #include <mutex>
 #include <thread>
 #include <cstring>
+#include <algorithm>
 
 #include "mining.hpp"
 #include "comm.hpp"
 #include "misc.hpp"
+#include "topology.hpp"
 
 extern std::atomic<bool> g_still_running;
 extern awaiting_threads_t g_all_awaiting_threads;
 
-CMineThread::CMineThread( std::uint32_t thread_id )
-    :   m_thread_id { thread_id },
-        m_condv_blck_no { std::make_shared<std::condition_variable>() },
-        m_condv_summary { std::make_shared<std::condition_variable>() } {
-}
-
-void CMineThread::CleanupSyncState() {
-    m_condv_blck_no->notify_one();
-    m_condv_summary->notify_one();
-}
-
-void CMineThread::SetBlockSummary( std::uint32_t hashes_count, double duration ) {
-    std::unique_lock<std::mutex> unique_lock_summary_lock( m_mutex_summary );
-    m_block_mining_duration = duration;
-    m_computed_hashes_count = hashes_count;
-    m_condv_summary->notify_one();
-}
-
-std::tuple<std::uint32_t, double> CMineThread::GetBlockSummary() {
-    std::unique_lock<std::mutex> unique_lock_summary_lock( m_mutex_summary );
-    auto result = awaiting_threads_handle( m_condv_summary,
-            std::this_thread::get_id(), g_all_awaiting_threads );
-    assert( result);
-    m_condv_summary->wait( unique_lock_summary_lock, [&]() {
-            return !g_still_running || m_computed_hashes_count > 0; } );
-    auto summary = std::make_tuple( m_computed_hashes_count, m_block_mining_duration );
-    m_computed_hashes_count = 0;
-    m_block_mining_duration = 0.;
-    if ( result ) {
-        awaiting_threads_release(
-                std::this_thread::get_id(), g_all_awaiting_threads );
+CSolutionRing::CSolutionRing()
+    :   m_slots { std::make_unique<CSlot[]>( DEFAULT_SOLUTIONS_RING_SIZE ) } {
+    for ( std::uint64_t pos = 0; pos < DEFAULT_SOLUTIONS_RING_SIZE; ++pos )
+        m_slots[pos].sequence.store( pos, std::memory_order_relaxed );
+}
+
+// by any thread, false when the ring is full
+bool CSolutionRing::Push( CSolution const & solution ) {
+    std::uint64_t pos { m_push_pos.load( std::memory_order_relaxed ) };
+    for ( ;; ) {
+        CSlot & slot { m_slots[pos & ( DEFAULT_SOLUTIONS_RING_SIZE - 1 )] };
+        std::int64_t const turn { std::int64_t( slot.sequence.load( std::memory_order_acquire ) - pos ) };
+        if ( turn == 0 ) {
+            if ( m_push_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                slot.solution = solution;
+                slot.sequence.store( pos + 1, std::memory_order_release );
+                return true;
+            }
+        } else if ( turn < 0 ) {
+            return false;
+        } else {
+            pos = m_push_pos.load( std::memory_order_relaxed );
+        }
     }
-    return summary;
+}
+
+// by the comm thread only, false when the ring is empty
+bool CSolutionRing::Pop( CSolution & solution ) {
+    CSlot & slot { m_slots[m_pop_pos & ( DEFAULT_SOLUTIONS_RING_SIZE - 1 )] };
+    if ( slot.sequence.load( std::memory_order_acquire ) != m_pop_pos + 1 ) return false;
+    solution = slot.solution;
+    slot.sequence.store( m_pop_pos + DEFAULT_SOLUTIONS_RING_SIZE, std::memory_order_release );
+    ++m_pop_pos;
+    return true;
+}
+
+// by the comm thread only
+bool CSolutionRing::Empty() const {
+    return m_slots[m_pop_pos & ( DEFAULT_SOLUTIONS_RING_SIZE - 1 )].sequence.load(
+            std::memory_order_acquire ) != m_pop_pos + 1;
+}
+
+// by the comm thread only
+void CSolutionRing::Clear() {
+    CSolution solution;
+    while ( this->Pop( solution ) );
 }
 
 inline
-void CMineThread::WaitTarget() {
-    std::unique_lock<std::mutex> unique_lock_blck_no( m_mutex_blck_no );
-    auto result = awaiting_threads_handle( m_condv_blck_no,
-            std::this_thread::get_id(), g_all_awaiting_threads );
-    assert( result);
-    m_condv_blck_no->wait( unique_lock_blck_no, [&]() {
-            return !g_still_running || m_blck_no > 0; } );
-    if ( result ) {
-        awaiting_threads_release(
-                std::this_thread::get_id(), g_all_awaiting_threads );
-    }
+CNosoStatKernel nosohash_stat_kernel( CNosoHashKernel kernel ) {
+    return kernel == CNosoHashKernel::SCALAR ? CNosoStatKernel::SCALAR
+        : kernel == CNosoHashKernel::SSE2 ? CNosoStatKernel::SSE2
+        : CNosoHasher::BestStatKernel();
+}
+
+// the nonces of a thread prefix, the 9 decimal digits after it
+constexpr static
+std::uint32_t const mining_prefix_counters { 1'000'000'000 };
+
+// The nonces of a slice of a thread hashing at rate while the fastest one
+// hashes at fastest_rate. The fastest thread hashes DEFAULT_HASHING_RANGE
+// nonces and the slower ones, e.g. on E-cores or LITTLE cores, less in
+// proportion, whole lanes, so every thread checks its job as often
+inline
+std::uint32_t mining_slice_size( double rate, double fastest_rate, std::uint32_t lanes ) {
+    if ( rate <= 0. || rate >= fastest_rate ) return DEFAULT_HASHING_RANGE;
+    std::uint32_t const slice_lanes = static_cast<std::uint32_t>( DEFAULT_HASHING_RANGE / lanes * rate / fastest_rate + .5 );
+    return std::max<std::uint32_t>( 1, slice_lanes ) * lanes;
+}
+
+CMineJob::CMineJob( CCommThread * comm, std::shared_ptr<CTarget> const & target )
+    :   comm { comm },
+        blck_no { target->blck_no + 1 },
+        prefix { target->prefix },
+        address { target->address },
+        hash_target { target->lb_hash.c_str(), std::min<std::size_t>( target->mn_diff.find_first_not_of( '0' ), 32 ) },
+        deadline { NOSO_BLOCK_AGE_INNER_MINING_PERIOD
+                ? noso_mining_period_deadline() : std::chrono::steady_clock::now() } {
+    assert( ( address.length() == 30 || address.length() == 31 )
+            && target->lb_hash.length() == 32
+            && target->mn_diff.length() == 32 );
+}
+
+bool CMineJob::IsRunnable() const {
+    return g_still_running
+        && active.load( std::memory_order_relaxed )
+        && std::chrono::steady_clock::now() < deadline
+        && !comm->IsBandedByPool()
+        && !comm->ReachedMaxShares();
+}
+
+// the shares a job still needs per thread hashing for it, the most needed
+// the more threads go stealing its items
+double CMineJob::GetDemand() const {
+    return double( comm->RemainingShares() ) / ( 1 + threads_count.load( std::memory_order_relaxed ) );
+}
+
+// cpu is the CPU to pin the thread to, -1 for none
+CMineThread::CMineThread( std::uint32_t thread_id, CNosoHashKernel kernel, std::int32_t cpu )
+    :   m_thread_id { thread_id },
+        m_kernel { nosohash_kernel_select( kernel ) },
+        m_cpu { cpu } {
+    assert( nosohash_kernel_supported( m_kernel ) );
+}
+
+// a job seeded into a thread makes it yield the item it is hashing
+void CMineThread::SeedItem( CMineItem const & item ) {
+    std::unique_lock<std::mutex> unique_lock_items( m_mutex_items );
+    m_items.push_back( item );
+    m_yield = true;
+}
+
+// refused while yielding, to keep the seed the newest item
+bool CMineThread::PushItem( CMineItem const & item ) {
+    std::unique_lock<std::mutex> unique_lock_items( m_mutex_items );
+    if ( m_yield ) return false;
+    m_items.push_back( item );
+    return true;
+}
+
+// a yielded item is left for the thieves
+void CMineThread::YieldItem( CMineItem const & item ) {
+    std::unique_lock<std::mutex> unique_lock_items( m_mutex_items );
+    m_items.push_front( item );
+}
+
+// the owner takes the newest item, the nonces next to the ones it has just
+// hashed or the seed it has yielded to
+bool CMineThread::PopItem( CMineItem & item ) {
+    std::unique_lock<std::mutex> unique_lock_items( m_mutex_items );
+    m_yield = false;
+    if ( m_items.empty() ) return false;
+    item = std::move( m_items.back() );
+    m_items.pop_back();
+    return true;
+}
+
+// the thieves take the oldest item, the biggest one left
+bool CMineThread::StealItem( CMineItem & item ) {
+    std::unique_lock<std::mutex> unique_lock_items( m_mutex_items );
+    if ( m_items.empty() ) return false;
+    item = std::move( m_items.front() );
+    m_items.pop_front();
+    return true;
+}
+
+// the demand of the job of the oldest item, after dropping the oldest items
+// no longer worth hashing, 0 when none is left
+double CMineThread::GetDemand() {
+    std::unique_lock<std::mutex> unique_lock_items( m_mutex_items );
+    while ( !m_items.empty() && !m_items.front().job->IsRunnable() ) m_items.pop_front();
+    return m_items.empty() ? 0. : m_items.front().job->GetDemand();
+}
+
+double CMineThread::GetHashrate() const {
+    std::uint64_t const usecs { m_hashing_usecs.load( std::memory_order_relaxed ) };
+    return usecs > 0 ? 1e6 * m_hashes_count.load( std::memory_order_relaxed ) / usecs : 0.;
+}
+
+// the hashes per second of the recent slices, a moving average kept up to
+// date slice by slice, 0 until the first one
+double CMineThread::GetSliceRate() const {
+    return m_slice_rate.load( std::memory_order_relaxed );
 }
 
+#ifdef NOSO_PROFILE
+// by the thread between its slices, so that its profile is never read while
+// a stage timer writes to it
 inline
-void CMineThread::DoneTarget() {
-    std::unique_lock<std::mutex> unique_lock_blck_no( m_mutex_blck_no );
-    m_blck_no = 0;
-    this->CleanupSyncState();
+void CMineThread::_PublishProfile() {
+    std::unique_lock<std::mutex> unique_lock_profile( m_mutex_profile );
+    m_profile_published.Merge( m_profile );
+    m_profile.Reset();
 }
 
-void CMineThread::NewTarget( const std::shared_ptr<CTarget> &target ) {
+void CMineThread::TakeProfile( CNosoThreadProfile & profile ) {
+    std::unique_lock<std::mutex> unique_lock_profile( m_mutex_profile );
+    profile = m_profile_published;
+    m_profile_published.Reset();
+}
+#endif // NOSO_PROFILE
+
+inline
+void CMineThread::_Init( CMineItem const & item ) {
     std::string thread_prefix = {
-        target->prefix
-        + nosohash_prefix( m_thread_id ) };
+        item.job->prefix
+        + nosohash_prefix( item.prefix_id ) };
     thread_prefix.append( 9 - thread_prefix.size(), '!' );
-    std::unique_lock<std::mutex> unique_lock_blck_no( m_mutex_blck_no );
     if ( m_prefix != thread_prefix
-        || m_address != target->address ) {
+        || m_address != item.job->address ) {
         std::strcpy( m_prefix, thread_prefix.c_str() );
-        std::strcpy( m_address, target->address.c_str() );
-        m_hasher.Init( m_prefix, m_address );
+        std::strcpy( m_address, item.job->address.c_str() );
+        if ( m_hasher ) m_hasher->Init( m_prefix, m_address );
+#ifdef NOSO_HASHING_X86
+        if ( m_hasher_avx2 ) m_hasher_avx2->Init( m_prefix, m_address );
+        if ( m_hasher_avx512 ) m_hasher_avx512->Init( m_prefix, m_address );
+#endif // NOSO_HASHING_X86
     }
-    std::strcpy( m_lb_hash, target->lb_hash.c_str() );
-    std::strcpy( m_mn_diff, target->mn_diff.c_str() );
-    m_blck_no = target->blck_no + 1;
-    m_condv_blck_no->notify_one();
 }
 
-void CMineThread::Mine( CCommThread * pCommThread ) {
-    m_exited = 0;
-    char best_diff[33];
-    while ( g_still_running ) {
-        this->WaitTarget();
-        if ( !g_still_running ) break;
-        assert( ( std::strlen( m_address ) == 30 || std::strlen( m_address ) == 31 )
-                && std::strlen( m_lb_hash ) == 32
-                && std::strlen( m_mn_diff ) == 32 );
-        std::strcpy( best_diff, m_mn_diff );
-        std::size_t match_len { 0 };
-        while ( best_diff[match_len] == '0' ) ++match_len;
-        std::uint32_t hashes_counter { 0 };
+void CMineThread::Mine( CMineScheduler & scheduler ) {
+    // only the hasher of the kernel is allocated, by the thread once pinned
+    // to have its state on the NUMA node of its CPU
+    if ( m_cpu >= 0 ) noso_pin_thread( m_cpu );
+    switch ( m_kernel ) {
+#ifdef NOSO_HASHING_X86
+    case CNosoHashKernel::AVX512: m_hasher_avx512 = std::make_unique<CNosoHasherAVX512>(); break;
+    case CNosoHashKernel::AVX2: m_hasher_avx2 = std::make_unique<CNosoHasherAVX2>(); break;
+#endif // NOSO_HASHING_X86
+    default: m_hasher = std::make_unique<CNosoHasher>( nosohash_stat_kernel( m_kernel ) ); break;
+    }
+    // dispatched once per thread, the hashing loop of each kernel is its own
+    // instance of _Mine with the hasher calls resolved at compile time
+    switch ( m_kernel ) {
+#ifdef NOSO_HASHING_X86
+    case CNosoHashKernel::AVX512: this->_Mine( scheduler, *m_hasher_avx512 ); break;
+    case CNosoHashKernel::AVX2: this->_Mine( scheduler, *m_hasher_avx2 ); break;
+#endif // NOSO_HASHING_X86
+    default: this->_Mine( scheduler, *m_hasher ); break;
+    }
+}
+
+template <typename THasher>
+void CMineThread::_Mine( CMineScheduler & scheduler, THasher & hasher ) {
+    static_assert( DEFAULT_HASHING_RANGE % THasher::LANES == 0 );
+    NOSO_PROFILE_THREAD( &m_profile );
+    std::vector<CNosoHashHit> hits;
+    CMineItem item;
+    while ( scheduler.TakeItem( m_thread_id, item ) ) {
+        CMineJob & job { *item.job };
+        this->_Init( item );
+        ++job.threads_count;
+        std::uint64_t hashes_count { 0 };
         auto begin_mining { std::chrono::steady_clock::now() };
-        while ( g_still_running
-                && NOSO_BLOCK_AGE_INNER_MINING_PERIOD ) {
-            if ( pCommThread->IsBandedByPool() ) {
-                break;
-            } else if ( pCommThread->ReachedMaxShares() ) {
-                awaiting_threads_wait_for( ( 585 - NOSO_BLOCK_AGE ) + 1,
-                        std::this_thread::get_id(),
-                        g_all_awaiting_threads,
-                        []() -> bool { return !g_still_running
-                                || NOSO_BLOCK_AGE_OUTER_MINING_PERIOD; } );
-            } else {
-                const char *base { m_hasher.GetBase( hashes_counter++ ) };
-                const char *hash { m_hasher.GetHash() };
-                assert( std::strlen( base ) == 18 && std::strlen( hash ) == 32 );
-                if ( std::strncmp( hash, m_lb_hash, match_len ) == 0 ) {
-                    pCommThread->AddSolution( std::make_shared<CSolution>( m_blck_no, base, hash, "" ) );
-                }
+        // the job and the pool states are only checked between slices of
+        // at most DEFAULT_HASHING_RANGE nonces, the pool states are atomics
+        // published by the comm thread
+        while ( item.counter_begin < item.counter_end && job.IsRunnable()
+                && !m_yield.load( std::memory_order_relaxed ) ) {
+            std::uint32_t const half { ( item.counter_end - item.counter_begin ) / 2
+                    / DEFAULT_HASHING_RANGE * DEFAULT_HASHING_RANGE };
+            if ( half > 0 && this->PushItem( { item.job, item.prefix_id,
+                    item.counter_begin + half, item.counter_end } ) ) {
+                scheduler.WakeIdle();
+                item.counter_end = item.counter_begin + half;
+            }
+            std::uint32_t const slice { mining_slice_size( m_slice_rate.load( std::memory_order_relaxed ),
+                    scheduler.GetFastestSliceRate(), THasher::LANES ) };
+            hits.clear();
+            auto const begin_slice { std::chrono::steady_clock::now() };
+            std::uint32_t const count { hasher.HashRange( item.counter_begin,
+                    std::min<std::uint32_t>( slice, item.counter_end - item.counter_begin ),
+                    job.hash_target, hits ) };
+            std::chrono::duration<double> const slice_secs { std::chrono::steady_clock::now() - begin_slice };
+            if ( count > 0 && slice_secs.count() > 0. ) {
+                // exponential moving average over about the last 8 slices
+                double const rate { count / slice_secs.count() };
+                double const slice_rate { m_slice_rate.load( std::memory_order_relaxed ) };
+                m_slice_rate.store( slice_rate > 0. ? slice_rate + ( rate - slice_rate ) / 8 : rate,
+                        std::memory_order_relaxed );
+            }
+#ifdef NOSO_PROFILE
+            this->_PublishProfile();
+#endif // NOSO_PROFILE
+            item.counter_begin += count;
+            hashes_count += count;
+            job.hashes_count.fetch_add( count, std::memory_order_relaxed );
+            for ( auto const & hit : hits ) {
+                const char *base { hasher.GetBase( hit.counter ) };
+                assert( std::strlen( base ) == 18 && std::strlen( hit.hash ) == 32 );
+                CSolution solution { job.blck_no, {}, {} };
+                std::memcpy( solution.base, base, sizeof( solution.base ) );
+                std::memcpy( solution.hash, hit.hash, sizeof( solution.hash ) );
+                job.comm->AddSolution( solution );
             }
         }
+        --job.threads_count;
+        if ( item.counter_begin < item.counter_end ) {
+            // yielded to a new seed
+            if ( job.IsRunnable() ) this->YieldItem( item );
+        } else if ( item.counter_begin >= mining_prefix_counters && job.IsRunnable() ) {
+            // all the nonces of the prefix are hashed, go on with a new one
+            CMineItem const next_item { item.job, job.prefixes_count++, 0, mining_prefix_counters };
+            if ( !this->PushItem( next_item ) ) this->YieldItem( next_item );
+        }
         auto end_mining { std::chrono::steady_clock::now() };
-        std::chrono::duration<double> elapsed_mining { end_mining - begin_mining };
-        this->SetBlockSummary( hashes_counter, elapsed_mining.count() );
-        this->DoneTarget();
-        if ( pCommThread->IsBandedByPool() ) {
-            break;
+        m_hashes_count.fetch_add( hashes_count, std::memory_order_relaxed );
+        m_hashing_usecs.fetch_add( std::chrono::duration_cast<std::chrono::microseconds>(
+                end_mining - begin_mining ).count(), std::memory_order_relaxed );
+        item.job.reset();
+    }
+}
+
+CMineScheduler::CMineScheduler( std::uint32_t threads_count, CNosoHashKernel kernel,
+        std::vector<pool_specs_t> const & pools, std::vector<std::uint32_t> const & cpus )
+    :   m_condv_idle { std::make_shared<std::condition_variable>() } {
+    assert( threads_count > 0 );
+    // pool i gets the threads from threads_count * (weights of pools before
+    // i) / (all weights), at least one even if it has to share it
+    std::uint64_t weights_sum { 0 };
+    for ( auto const & pool : pools ) weights_sum += std::get<3>( pool );
+    std::uint64_t weights_before { 0 };
+    for ( auto const & pool : pools ) {
+        std::uint32_t first = static_cast<std::uint32_t>( threads_count * weights_before / weights_sum );
+        weights_before += std::get<3>( pool );
+        std::uint32_t last = static_cast<std::uint32_t>( threads_count * weights_before / weights_sum );
+        if ( first >= last ) {
+            first = std::min( first, threads_count - 1 );
+            last = first + 1;
         }
-    } // END while ( g_still_running ) {
-    m_exited = 1;
+        m_pool_threads.push_back( std::make_tuple( first, last - first ) );
+    }
+    for ( std::uint32_t thread_id = 0; thread_id < threads_count; ++thread_id )
+        m_mine_objects.push_back( std::make_shared<CMineThread>( thread_id, kernel,
+                cpus.empty() ? -1 : std::int32_t( cpus[thread_id % cpus.size()] ) ) );
+    for ( auto const & mine_object : m_mine_objects )
+        m_mine_threads.emplace_back( &CMineThread::Mine, mine_object, std::ref( *this ) );
+}
+
+std::vector<std::shared_ptr<CMineThread>> const & CMineScheduler::MineObjects() const {
+    return m_mine_objects;
+}
+
+std::shared_ptr<CMineJob> CMineScheduler::NewJob( std::size_t pool_index, CCommThread * comm,
+        std::shared_ptr<CTarget> const & target ) {
+    assert( pool_index < m_pool_threads.size() );
+    auto job { std::make_shared<CMineJob>( comm, target ) };
+    auto const [first, count] = m_pool_threads[pool_index];
+    job->prefixes_count = count;
+    for ( std::uint32_t prefix_id = 0; prefix_id < count; ++prefix_id )
+        m_mine_objects[first + prefix_id]->SeedItem( { job, prefix_id, 0, mining_prefix_counters } );
+    std::unique_lock<std::mutex> unique_lock_idle( m_mutex_idle );
+    ++m_pushes_count;
+    m_condv_idle->notify_all();
+    return job;
+}
+
+void CMineScheduler::DoneJob( std::shared_ptr<CMineJob> const & job ) {
+    if ( job ) job->active = false;
 }
 
+// wakes the idle threads, if any, to steal the item just pushed
+void CMineScheduler::WakeIdle() {
+    if ( m_idle_count.load() <= 0 ) return;
+    std::unique_lock<std::mutex> unique_lock_idle( m_mutex_idle );
+    ++m_pushes_count;
+    m_condv_idle->notify_all();
+}
+
+bool CMineScheduler::TakeItem( std::uint32_t thread_id, CMineItem & item ) {
+    std::size_t const threads_count { m_mine_objects.size() };
+    auto const take_runnable = [&]() -> bool {
+        while ( m_mine_objects[thread_id]->PopItem( item ) )
+            if ( item.job->IsRunnable() ) return true;
+        // steal from the thread whose oldest item needs the threads the most
+        for ( ;; ) {
+            CMineThread * victim { nullptr };
+            double victim_demand { 0. };
+            for ( std::size_t i = 1; i < threads_count; ++i ) {
+                CMineThread * const other { m_mine_objects[( thread_id + i ) % threads_count].get() };
+                double const demand { other->GetDemand() };
+                if ( demand > victim_demand ) {
+                    victim = other;
+                    victim_demand = demand;
+                }
+            }
+            if ( !victim ) return false;
+            if ( victim->StealItem( item ) && item.job->IsRunnable() ) return true;
+        }
+    };
+    while ( g_still_running ) {
+        if ( take_runnable() ) return true;
+        // announce the idling before looking again, a push seen by neither
+        // look wakes it up
+        std::uint64_t pushes_count;
+        {
+            std::unique_lock<std::mutex> unique_lock_idle( m_mutex_idle );
+            pushes_count = m_pushes_count;
+        }
+        ++m_idle_count;
+        if ( take_runnable() ) {
+            --m_idle_count;
+            return true;
+        }
+        std::unique_lock<std::mutex> unique_lock_idle( m_mutex_idle );
+        auto result = awaiting_threads_handle( m_condv_idle,
+                std::this_thread::get_id(), g_all_awaiting_threads );
+        assert( result );
+        m_condv_idle->wait_for( unique_lock_idle, std::chrono::seconds( 1 ), [&]() {
+                return !g_still_running || m_pushes_count != pushes_count; } );
+        if ( result ) {
+            awaiting_threads_release(
+                    std::this_thread::get_id(), g_all_awaiting_threads );
+        }
+        --m_idle_count;
+    }
+    item = CMineItem {};
+    return false;
+}
+
+std::vector<std::tuple<std::uint32_t, double>> CMineScheduler::GetThreadHashrates() const {
+    std::vector<std::tuple<std::uint32_t, double>> thread_hashrates;
+    for ( auto const & mine_object : m_mine_objects )
+        thread_hashrates.push_back( std::make_tuple( mine_object->m_thread_id, mine_object->GetHashrate() ) );
+    return thread_hashrates;
+}
+
+// the slice rate of the fastest thread, the one hashing slices of
+// DEFAULT_HASHING_RANGE nonces
+double CMineScheduler::GetFastestSliceRate() const {
+    double fastest_rate { 0. };
+    for ( auto const & mine_object : m_mine_objects )
+        fastest_rate = std::max( fastest_rate, mine_object->GetSliceRate() );
+    return fastest_rate;
+}
+
+#ifdef NOSO_PROFILE
+// the profiles the threads published since the last report, taken by the
+// first comm thread to report the block blck_no, so that the pools sharing
+// the threads report them once per block between them
+bool CMineScheduler::TakeProfiles( std::uint32_t blck_no, std::vector<CNosoThreadProfile> & profiles ) {
+    std::uint32_t profiled_blck_no { m_profiled_blck_no.load() };
+    do {
+        if ( profiled_blck_no >= blck_no ) return false;
+    } while ( !m_profiled_blck_no.compare_exchange_weak( profiled_blck_no, blck_no ) );
+    profiles.resize( m_mine_objects.size() );
+    for ( std::size_t i = 0; i < m_mine_objects.size(); ++i )
+        m_mine_objects[i]->TakeProfile( profiles[i] );
+    return true;
+}
+#endif // NOSO_PROFILE
+
+// the threads stop at their next slice or idle wake up once g_still_running
+// is false
+void CMineScheduler::Stop() {
+    assert( !g_still_running );
+    {
+        std::unique_lock<std::mutex> unique_lock_idle( m_mutex_idle );
+        m_condv_idle->notify_all();
+    }
+    for ( auto & mine_thread : m_mine_threads ) mine_thread.join();
+    m_mine_threads.clear();
+}
@@ -5,23 +5,49 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include <deque>
+#include <mutex>
+#include <tuple>
+#include <memory>
 #include <atomic>
+#include <thread>
+#include <vector>
 #include <cassert>
 #include <condition_variable>
 
 #include "noso-2m.hpp"
 #include "hashing.hpp"
+#include "profile.hpp"
 
+// A hit of the mining threads, of fixed size so that it goes to its pool
+// through the slots of a CSolutionRing without any allocation
 struct CSolution {
     std::uint32_t blck;
-    std::string base;
-    std::string hash;
-    std::string diff;
-    CSolution( std::uint32_t blck, const char base[19], const char hash[33], const char diff[33] )
-        :   blck { blck }, base { base }, hash { hash }, diff { diff } {
-        assert( std::strlen( base ) == 18 && std::strlen( hash ) == 32
-               && ( std::strlen( diff ) == 0 || std::strlen( diff ) == 32 ) );
-    }
+    char base[19];
+    char hash[33];
+};
+
+// Bounded lock-free queue of the solutions of a pool, many mining threads
+// push and the comm thread pops. The slots are allocated once with the ring.
+// The sequence of a slot tells whose turn it is: the one of the push at
+// position pos when it is pos, the one of the pop at pos when it is pos + 1
+class CSolutionRing {
+    static_assert( ( DEFAULT_SOLUTIONS_RING_SIZE & ( DEFAULT_SOLUTIONS_RING_SIZE - 1 ) ) == 0 );
+    struct CSlot {
+        std::atomic<std::uint64_t> sequence;
+        CSolution solution;
+    };
+    std::unique_ptr<CSlot[]> const m_slots;
+    alignas( 64 ) std::atomic<std::uint64_t> m_push_pos { 0 };
+    alignas( 64 ) std::uint64_t m_pop_pos { 0 };
+public:
+    CSolutionRing();
+    CSolutionRing( const CSolutionRing& ) = delete; // Copy prohibited
+    CSolutionRing& operator=( const CSolutionRing& ) = delete; // Assignment prohibited
+    bool Push( CSolution const & solution );
+    bool Pop( CSolution & solution );
+    bool Empty() const;
+    void Clear();
 };
 
 struct CTarget {
@@ -70,33 +96,125 @@ struct CPoolTarget : public CTarget {
 
 class CCommThread;
 
+// A block target of a pool as the mining threads see it, active from NewJob
+// until DoneJob or its mining period deadline. The hashes every thread does
+// for the job are added to hashes_count, prefixes_count numbers the next
+// thread prefix to hash once the nonces of the seeded ones run out and
+// threads_count counts the threads hashing the job
+struct CMineJob {
+    CCommThread * const comm;
+    std::uint32_t const blck_no;
+    std::string const prefix;
+    std::string const address;
+    CNosoHashTarget const hash_target;
+    std::chrono::steady_clock::time_point const deadline;
+    std::atomic<bool> active { true };
+    std::atomic<std::uint64_t> hashes_count { 0 };
+    std::atomic<std::uint32_t> prefixes_count { 0 };
+    std::atomic<std::uint32_t> threads_count { 0 };
+    CMineJob( CCommThread * comm, std::shared_ptr<CTarget> const & target );
+    bool IsRunnable() const;
+    double GetDemand() const;
+};
+
+// The unit of work of the scheduler, the nonces counter_begin..counter_end-1
+// of a job hashed after the thread prefix numbered prefix_id
+struct CMineItem {
+    std::shared_ptr<CMineJob> job;
+    std::uint32_t prefix_id;
+    std::uint32_t counter_begin;
+    std::uint32_t counter_end;
+};
+
+class CMineScheduler;
+
 class CMineThread {
 public:
     std::uint32_t const m_thread_id;
-    std::atomic<short> m_exited { 0 };
 protected:
-    CNosoHasher m_hasher;
-    char m_address[32];
-    char m_prefix[10];
-    std::uint32_t m_blck_no { 0 };
-    char m_lb_hash[33];
-    char m_mn_diff[33];
-    std::uint32_t m_computed_hashes_count { 0 };
-    double m_block_mining_duration { 0. };
-    mutable std::mutex m_mutex_blck_no;
-    mutable std::mutex m_mutex_summary;
-    std::shared_ptr<std::condition_variable> const m_condv_blck_no;
-    std::shared_ptr<std::condition_variable> const m_condv_summary;
+#ifdef NOSO_PROFILE
+    // the stages timed by the thread since its last slice, written by the
+    // thread alone, and the ones of the slices it has published since the
+    // last report, taken by the reporter under m_mutex_profile
+    CNosoThreadProfile m_profile;
+    mutable std::mutex m_mutex_profile;
+    CNosoThreadProfile m_profile_published;
+    void _PublishProfile();
+#endif // NOSO_PROFILE
+    CNosoHashKernel const m_kernel;
+    std::int32_t const m_cpu;
+    std::unique_ptr<CNosoHasher> m_hasher;
+#ifdef NOSO_HASHING_X86
+    std::unique_ptr<CNosoHasherAVX2> m_hasher_avx2;
+    std::unique_ptr<CNosoHasherAVX512> m_hasher_avx512;
+#endif // NOSO_HASHING_X86
+    char m_address[32] {};
+    char m_prefix[10] {};
+    std::atomic<std::uint64_t> m_hashes_count { 0 };
+    std::atomic<std::uint64_t> m_hashing_usecs { 0 };
+    std::atomic<double> m_slice_rate { 0. };
+    mutable std::mutex m_mutex_items;
+    std::deque<CMineItem> m_items;
+    std::atomic<bool> m_yield { false };
+    void _Init( CMineItem const & item );
+    template <typename THasher>
+    void _Mine( CMineScheduler & scheduler, THasher & hasher );
 public:
-    CMineThread( std::uint32_t thread_id );
+    CMineThread( std::uint32_t thread_id, CNosoHashKernel kernel, std::int32_t cpu );
     virtual ~CMineThread() = default;
-    void CleanupSyncState();
-    void WaitTarget();
-    void DoneTarget();
-    void NewTarget( const std::shared_ptr<CTarget> &target );
-    void SetBlockSummary( std::uint32_t hashes_count, double duration );
-    std::tuple<std::uint32_t, double> GetBlockSummary();
-    virtual void Mine( CCommThread * pCommThread );
+    void SeedItem( CMineItem const & item );
+    bool PushItem( CMineItem const & item );
+    void YieldItem( CMineItem const & item );
+    bool PopItem( CMineItem & item );
+    bool StealItem( CMineItem & item );
+    double GetDemand();
+    double GetHashrate() const;
+    double GetSliceRate() const;
+#ifdef NOSO_PROFILE
+    void TakeProfile( CNosoThreadProfile & profile );
+#endif // NOSO_PROFILE
+    virtual void Mine( CMineScheduler & scheduler );
+};
+
+// The hashing threads of the process, shared by all the pools. Each thread
+// owns a deque of items: it takes its newest one, splits off the upper half
+// of the nonces for the thieves and hashes the lower half slice by slice, and
+// when its deque runs dry it steals the oldest item of another thread. A new
+// job is seeded into the deques of the threads its pool's weight gives it,
+// so the pools share the threads in proportion to their weights. A pool
+// which has got its max shares leaves its threads to steal from the pools
+// with the most shares left per thread hashing for them, until the threads
+// yield to their own pools at the next target
+class CMineScheduler {
+    std::vector<std::shared_ptr<CMineThread>> m_mine_objects;
+    std::vector<std::thread> m_mine_threads;
+    std::vector<std::tuple<std::uint32_t, std::uint32_t>> m_pool_threads;
+    mutable std::mutex m_mutex_idle;
+    std::shared_ptr<std::condition_variable> const m_condv_idle;
+    std::uint64_t m_pushes_count { 0 };
+    std::atomic<std::uint32_t> m_idle_count { 0 };
+#ifdef NOSO_PROFILE
+    std::atomic<std::uint32_t> m_profiled_blck_no { 0 };
+#endif // NOSO_PROFILE
+public:
+    CMineScheduler( std::uint32_t threads_count, CNosoHashKernel kernel,
+            std::vector<pool_specs_t> const & pools, std::vector<std::uint32_t> const & cpus );
+    CMineScheduler( const CMineScheduler& ) = delete; // Copy prohibited
+    CMineScheduler( CMineScheduler&& ) = delete; // Move prohibited
+    void operator=( const CMineScheduler& ) = delete; // Assignment prohibited
+    CMineScheduler& operator=( CMineScheduler&& ) = delete; // Move assignment prohibited
+    std::vector<std::shared_ptr<CMineThread>> const & MineObjects() const;
+    std::shared_ptr<CMineJob> NewJob( std::size_t pool_index, CCommThread * comm,
+            std::shared_ptr<CTarget> const & target );
+    void DoneJob( std::shared_ptr<CMineJob> const & job );
+    bool TakeItem( std::uint32_t thread_id, CMineItem & item );
+    void WakeIdle();
+    std::vector<std::tuple<std::uint32_t, double>> GetThreadHashrates() const;
+    double GetFastestSliceRate() const;
+#ifdef NOSO_PROFILE
+    bool TakeProfiles( std::uint32_t blck_no, std::vector<CNosoThreadProfile> & profiles );
+#endif // NOSO_PROFILE
+    void Stop();
 };
 
 #endif // __NOSO2M__MINING_HPP__
@@ -9,13 +9,21 @@
 
 #include "misc.hpp"
 #include "output.hpp"
+#include "hashing.hpp"
+#include "topology.hpp"
+#include "bench.hpp"
+#include "util.hpp"
 
 extern char g_miner_address[];
 extern std::uint32_t g_pool_shares_limit;
-extern std::uint32_t g_pool_threads_count;
+extern std::uint32_t g_pool_inflight_shares;
+extern std::uint32_t g_mining_threads_count;
 extern std::vector<pool_specs_t> g_mining_pools;
 extern char g_binding_address[];
 extern CLogLevel g_logging_level;
+extern CNosoHashKernel g_hash_kernel;
+extern CNosoAffinity g_threads_affinity;
+extern std::vector<std::uint32_t> g_affinity_cpus;
 
 inline
 bool is_valid_address( std::string const & address ) {
@@ -29,6 +37,32 @@ bool is_valid_threads( std::uint32_t count ) {
     return true;
 }
 
+// a threads count, or auto for as many as the usable CPUs, 0
+inline
+bool parse_threads( std::string const & str, int & threads ) {
+    if ( str == "auto" ) {
+        threads = 0;
+        return true;
+    }
+    if ( str.empty() || str.length() > 6 || str.find_first_not_of( "0123456789" ) != std::string::npos )
+        return false;
+    threads = std::stoi( str );
+    return is_valid_threads( threads );
+}
+
+inline
+bool is_valid_hasher( std::string const & hasher ) {
+    CNosoHashKernel kernel;
+    return nosohash_kernel_from_name( hasher, kernel );
+}
+
+inline
+bool is_valid_affinity( std::string const & affinity ) {
+    CNosoAffinity policy;
+    std::vector<std::uint32_t> cpus;
+    return noso_affinity_from_name( affinity, policy, cpus );
+}
+
 inline
 bool is_valid_ipv4addr( std::string const & ipv4_address ) {
     const std::regex re_ipv4 {
@@ -66,9 +100,14 @@ std::vector<pool_specs_t> parse_pools_argv( std::string const & poolstr ) {
             "(\\:"
                 "("
                     "6553[0-5]|655[0-2][0-9]|65[0-4][0-9]{2}|6[0-4][0-9]{3}|[1-5][0-9]{4}|[0-5]{0,5}|[0-9]{1,4}"
-                ")$"
+                ")"
             ")?"
         ")?"
+        "(\\*"
+            "("
+                "[1-9][0-9]{0,2}"
+            ")"
+        ")?"
         "$"
     };
     std::vector<pool_specs_t> mining_pools;
@@ -82,10 +121,12 @@ std::vector<pool_specs_t> parse_pools_argv( std::string const & poolstr ) {
                             std::string name { sm0[1].str() };
                             std::string host { sm0[3].str() };
                             std::string port { sm0[13].str() };
+                            std::string weight { sm0[15].str() };
                             if ( name.length() <= 0 ) return;
                             if ( host.length() <= 0 ) return;
                             if ( port.length() <= 0 ) port = std::string { "8082" };
-                            mining_pools.push_back( { name, host, port } );
+                            mining_pools.push_back( { name, host, port, weight.length() > 0
+                                    ? std::uint32_t( std::stoul( weight ) ) : DEFAULT_POOL_WEIGHT } );
                         }
                     );
             }
@@ -95,23 +136,35 @@ std::vector<pool_specs_t> parse_pools_argv( std::string const & poolstr ) {
 
 struct _mining_options_t {
     int shares;
+    int inflight;
     int threads;
     std::string address;
     std::string pools;
     std::string filename;
     std::string logging;
     std::string binding;
+    std::string hasher;
+    std::string affinity;
+    std::string autotune;
 }   _g_arg_options = {
         .shares = DEFAULT_POOL_SHARES_LIMIT,
-        .threads = DEFAULT_POOL_THREADS_COUNT,
+        .inflight = DEFAULT_POOL_INFLIGHT_SHARES,
+        .threads = DEFAULT_MINING_THREADS_COUNT,
         .logging = DEFAULT_LOGGING_LEVEL,
         .binding = DEFAULT_BINDING_IPV4ADDR,
+        .hasher = DEFAULT_HASHING_KERNEL,
+        .affinity = DEFAULT_THREADS_AFFINITY,
+        .autotune = "",
     },
     _g_cfg_options = {
         .shares = DEFAULT_POOL_SHARES_LIMIT,
-        .threads = DEFAULT_POOL_THREADS_COUNT,
+        .inflight = DEFAULT_POOL_INFLIGHT_SHARES,
+        .threads = DEFAULT_MINING_THREADS_COUNT,
         .logging = DEFAULT_LOGGING_LEVEL,
         .binding = DEFAULT_BINDING_IPV4ADDR,
+        .hasher = DEFAULT_HASHING_KERNEL,
+        .affinity = DEFAULT_THREADS_AFFINITY,
+        .autotune = "",
     };
 
 inline
@@ -120,10 +173,12 @@ void process_arg_options( cxxopts::ParseResult const & parsed_options ) {
         _g_arg_options.address = parsed_options["address"].as<std::string>();
         if ( !is_valid_address( _g_arg_options.address ) )
             throw std::invalid_argument( "Invalid miner address argument" );
-        _g_arg_options.threads = parsed_options["threads"].as<std::uint32_t>();
-        if ( !is_valid_threads( _g_arg_options.threads ) )
+        if ( !parse_threads( parsed_options["threads"].as<std::string>(), _g_arg_options.threads ) )
             throw std::invalid_argument( "Invalid threads count argument" );
         _g_arg_options.shares = parsed_options["shares"].as<std::uint32_t>();
+        _g_arg_options.inflight = parsed_options["inflight"].as<std::uint32_t>();
+        if ( _g_arg_options.inflight < 1 )
+            throw std::invalid_argument( "Invalid shares in flight argument" );
         auto pools = parsed_options["pools"].as<std::vector<std::string>>();
         std::string pools_str;
         for ( auto e : pools ) {
@@ -140,6 +195,14 @@ void process_arg_options( cxxopts::ParseResult const & parsed_options ) {
         if ( !( _g_arg_options.binding == "none" )
                 && !is_valid_ipv4addr( _g_arg_options.binding ) )
             throw std::invalid_argument( "Invalid binding argument (an IPv4 address)" );
+        _g_arg_options.hasher = parsed_options["hasher"].as<std::string>();
+        if ( !is_valid_hasher( _g_arg_options.hasher ) )
+            throw std::invalid_argument( "Invalid hasher argument" );
+        _g_arg_options.affinity = parsed_options["affinity"].as<std::string>();
+        if ( !is_valid_affinity( _g_arg_options.affinity ) )
+            throw std::invalid_argument( "Invalid affinity argument" );
+        if ( parsed_options.count( "autotune" ) )
+            _g_arg_options.autotune = parsed_options["autotune"].as<std::string>();
     } catch( const std::invalid_argument& e ) {
         std::string msg { e.what() };
         NOSO_LOG_FATAL << msg << std::endl;
@@ -176,11 +239,14 @@ void process_cfg_options( cxxopts::ParseResult const & parsed_options ) {
                     if ( !is_valid_address( _g_cfg_options.address ) )
                         throw std::invalid_argument( "Invalid address config" );
                 } else if ( line_str.rfind( "threads ", 0 ) == 0 ) {
-                    _g_cfg_options.threads = std::stoul( line_str.substr( 8 ) );
-                    if ( !is_valid_threads( _g_cfg_options.threads ) )
+                    if ( !parse_threads( line_str.substr( 8 ), _g_cfg_options.threads ) )
                         throw std::invalid_argument( "Invalid threads count config" );
                 } else if ( line_str.rfind( "shares ", 0 ) == 0 ) {
                     _g_cfg_options.shares = std::stoul( line_str.substr( 7 ) );
+                } else if ( line_str.rfind( "inflight ", 0 ) == 0 ) {
+                    _g_cfg_options.inflight = std::stoul( line_str.substr( 9 ) );
+                    if ( _g_cfg_options.inflight < 1 )
+                        throw std::invalid_argument( "Invalid shares in flight config" );
                 } else if ( line_str.rfind( "pools ",   0 ) == 0 ) {
                     if ( _g_cfg_options.pools.size() > 0 ) _g_cfg_options.pools += ";";
                     _g_cfg_options.pools += line_str.substr( 6 );
@@ -194,6 +260,16 @@ void process_cfg_options( cxxopts::ParseResult const & parsed_options ) {
                     if ( !( _g_cfg_options.binding == "none" )
                             && !is_valid_ipv4addr( _g_cfg_options.binding ) )
                         throw std::invalid_argument( "Invalid binding config (an IPv4 address)" );
+                } else if ( line_str.rfind( "hasher ", 0 ) == 0 ) {
+                    _g_cfg_options.hasher = line_str.substr( 7 );
+                    if ( !is_valid_hasher( _g_cfg_options.hasher ) )
+                        throw std::invalid_argument( "Invalid hasher config" );
+                } else if ( line_str.rfind( "affinity ", 0 ) == 0 ) {
+                    _g_cfg_options.affinity = line_str.substr( 9 );
+                    if ( !is_valid_affinity( _g_cfg_options.affinity ) )
+                        throw std::invalid_argument( "Invalid affinity config" );
+                } else if ( line_str.rfind( "autotune ", 0 ) == 0 ) {
+                    _g_cfg_options.autotune = line_str.substr( 9 );
                 }
             }
         } catch( const std::invalid_argument& e ) {
@@ -205,6 +281,35 @@ void process_cfg_options( cxxopts::ParseResult const & parsed_options ) {
     }
 }
 
+// Replaces the hashing kernel and the threads count by the fastest ones
+// measured on this host, or by the ones an earlier start cached in the file
+inline
+void process_autotune( std::string const & filename, CNosoHashKernel kernel ) {
+    CBenchResult result;
+    bool const cached { CBenchmark::LoadTune( filename, kernel, g_affinity_cpus, result ) };
+    if ( !cached ) {
+        std::string msg { "Autotune measuring hashing kernels and threads..." };
+        NOSO_LOG_INFO << msg << std::endl;
+        NOSO_TUI_OutputHistPad( msg.c_str() );
+        NOSO_TUI_OutputHistWin();
+        result = CBenchmark::Tune( kernel, g_affinity_cpus );
+        if ( !CBenchmark::SaveTune( filename, kernel, g_affinity_cpus, result ) ) {
+            msg = "Can not write autotune file '" + filename + "'";
+            NOSO_LOG_WARN << msg << std::endl;
+            NOSO_TUI_OutputHistPad( msg.c_str() );
+        }
+    }
+    char msg[200];
+    std::snprintf( msg, 200, "Autotune %s: %s with %u threads, %.02f%c hashes/s",
+            cached ? "loaded" : "measured", nosohash_kernel_name( result.kernel ), result.threads,
+            hashrate_pretty_value( result.hashrate ), hashrate_pretty_unit( result.hashrate ) );
+    NOSO_LOG_INFO << msg << std::endl;
+    NOSO_TUI_OutputHistPad( msg );
+    NOSO_TUI_OutputHistWin();
+    g_hash_kernel = result.kernel;
+    g_mining_threads_count = result.threads;
+}
+
 void process_options( cxxopts::ParseResult const & parsed_options ) {
     process_cfg_options( parsed_options );
     process_arg_options( parsed_options );
@@ -220,11 +325,22 @@ void process_options( cxxopts::ParseResult const & parsed_options ) {
     std::string sel_binding {
         _g_arg_options.binding != DEFAULT_BINDING_IPV4ADDR  ? _g_arg_options.binding
             : _g_cfg_options.binding.length() > 0 ? _g_cfg_options.binding : DEFAULT_BINDING_IPV4ADDR };
+    std::string sel_hasher {
+        _g_arg_options.hasher != DEFAULT_HASHING_KERNEL ? _g_arg_options.hasher
+            : _g_cfg_options.hasher.length() > 0 ? _g_cfg_options.hasher : DEFAULT_HASHING_KERNEL };
+    std::string sel_affinity {
+        _g_arg_options.affinity != DEFAULT_THREADS_AFFINITY ? _g_arg_options.affinity
+            : _g_cfg_options.affinity.length() > 0 ? _g_cfg_options.affinity : DEFAULT_THREADS_AFFINITY };
+    std::string sel_autotune {
+        _g_arg_options.autotune.length() > 0 ? _g_arg_options.autotune : _g_cfg_options.autotune };
     std::strncpy( g_miner_address, sel_address.c_str(), 32 );
     g_pool_shares_limit = _g_arg_options.shares != DEFAULT_POOL_SHARES_LIMIT ? _g_arg_options.shares
         : _g_cfg_options.shares != DEFAULT_POOL_SHARES_LIMIT ? _g_cfg_options.shares : DEFAULT_POOL_SHARES_LIMIT;
-    g_pool_threads_count = _g_arg_options.threads != DEFAULT_POOL_THREADS_COUNT ? _g_arg_options.threads
-        : _g_cfg_options.threads != DEFAULT_POOL_THREADS_COUNT ? _g_cfg_options.threads : DEFAULT_POOL_THREADS_COUNT;
+    g_pool_inflight_shares = _g_arg_options.inflight != DEFAULT_POOL_INFLIGHT_SHARES ? _g_arg_options.inflight
+        : _g_cfg_options.inflight != DEFAULT_POOL_INFLIGHT_SHARES ? _g_cfg_options.inflight : DEFAULT_POOL_INFLIGHT_SHARES;
+    g_mining_threads_count = _g_arg_options.threads != DEFAULT_MINING_THREADS_COUNT ? _g_arg_options.threads
+        : _g_cfg_options.threads != DEFAULT_MINING_THREADS_COUNT ? _g_cfg_options.threads : DEFAULT_MINING_THREADS_COUNT;
+    if ( g_mining_threads_count == 0 ) g_mining_threads_count = noso_usable_cpus();
     g_logging_level = sel_logging == "info" ? CLogLevel::INFO : CLogLevel::DEBUG;
     if ( sel_binding == "none" ) {
         g_binding_address[0] = '\0';
@@ -232,6 +348,19 @@ void process_options( cxxopts::ParseResult const & parsed_options ) {
         std::strncpy( g_binding_address, sel_binding.c_str(), 16 );
     }
     g_mining_pools = parse_pools_argv( sel_pools );
+    std::vector<std::uint32_t> affinity_cpus;
+    noso_affinity_from_name( sel_affinity, g_threads_affinity, affinity_cpus );
+    g_affinity_cpus = noso_affinity_cpus( g_threads_affinity, affinity_cpus );
+    CNosoHashKernel kernel { CNosoHashKernel::AUTO };
+    nosohash_kernel_from_name( sel_hasher, kernel );
+    if ( !nosohash_kernel_supported( kernel ) ) {
+        std::string msg { "Hasher '" + sel_hasher + "' is not supported by this CPU" };
+        NOSO_LOG_FATAL << msg << std::endl;
+        NOSO_TUI_OutputHistPad( msg.c_str() );
+        throw std::bad_exception();
+    }
+    g_hash_kernel = nosohash_kernel_select( kernel );
+    if ( sel_autotune.length() > 0 ) process_autotune( sel_autotune, kernel );
 }
 
 bool awaiting_threads_handle(
@@ -26,14 +26,22 @@
 #include "inet.hpp"
 #include "comm.hpp"
 #include "output.hpp"
+#include "hashing.hpp"
+#include "bench.hpp"
+#include "topology.hpp"
 
 char g_miner_address[32] { DEFAULT_MINER_ADDRESS };
 std::atomic<bool> g_still_running { true };
+std::atomic<std::int64_t> g_network_clock_offset { noso_system_clock_offset() };
 std::uint32_t g_pool_shares_limit { DEFAULT_POOL_SHARES_LIMIT };
-std::uint32_t g_pool_threads_count { DEFAULT_POOL_THREADS_COUNT };
+std::uint32_t g_pool_inflight_shares { DEFAULT_POOL_INFLIGHT_SHARES };
+std::uint32_t g_mining_threads_count { DEFAULT_MINING_THREADS_COUNT };
 char g_binding_address[INET_ADDRSTRLEN] = { '\0' };
 CLogLevel g_logging_level { CLogLevel::INFO };
 std::vector<pool_specs_t> g_mining_pools;
+CNosoHashKernel g_hash_kernel { CNosoHashKernel::AUTO };
+CNosoAffinity g_threads_affinity { CNosoAffinity::NONE };
+std::vector<std::uint32_t> g_affinity_cpus;
 
 std::vector<std::tuple<std::uint32_t, double>> g_last_block_thread_hashrates;
 awaiting_threads_t g_all_awaiting_threads;
@@ -43,11 +51,20 @@ int main( int argc, char *argv[] ) {
     command_options.add_options()
         ( "c,config",   "Configuration file",       cxxopts::value<std::string>()->default_value( DEFAULT_CONFIG_FILENAME ) )
         ( "a,address",  "Original noso address",    cxxopts::value<std::string>()->default_value( DEFAULT_MINER_ADDRESS ) )
-        ( "t,threads",  "Num. threads per pool",    cxxopts::value<std::uint32_t>()->default_value( std::to_string( DEFAULT_POOL_THREADS_COUNT ) ) )
+        ( "t,threads",  "Num. hashing threads|auto", cxxopts::value<std::string>()->default_value( std::to_string( DEFAULT_MINING_THREADS_COUNT ) ) )
         ( "s,shares",   "Shares limit per pool",    cxxopts::value<std::uint32_t>()->default_value( std::to_string( DEFAULT_POOL_SHARES_LIMIT ) ) )
+        ( "inflight",   "Shares in flight per pool", cxxopts::value<std::uint32_t>()->default_value( std::to_string( DEFAULT_POOL_INFLIGHT_SHARES ) ) )
         ( "p,pools",    "Mining pools list",        cxxopts::value<std::vector<std::string>>()->default_value( DEFAULT_POOL_URL_LIST ) )
         ( "b,binding",  "Binding none|IPv4",        cxxopts::value<std::string>()->default_value( DEFAULT_BINDING_IPV4ADDR ) )
         ( "l,logging",  "Logging info/debug",       cxxopts::value<std::string>()->default_value( DEFAULT_LOGGING_LEVEL ) )
+        ( "hasher",     "Hashing kernel auto|scalar|sse2|avx2|avx512",
+                                                    cxxopts::value<std::string>()->default_value( DEFAULT_HASHING_KERNEL ) )
+        ( "affinity",   "Pinning hashing threads none|auto|CPU-LIST",
+                                                    cxxopts::value<std::string>()->default_value( DEFAULT_THREADS_AFFINITY ) )
+        ( "bench",      "Benchmark hashing offline, JSON report file (- for stdout)",
+                                                    cxxopts::value<std::string>()->implicit_value( DEFAULT_BENCH_FILENAME ) )
+        ( "autotune",   "Pick the fastest hasher and threads at start, cache file",
+                                                    cxxopts::value<std::string>()->implicit_value( DEFAULT_TUNE_FILENAME ) )
         ( "v,version",  "Print version" )
         ( "h,help",     "Print usage" )
         ;
@@ -67,6 +84,23 @@ int main( int argc, char *argv[] ) {
         NOSO_STDOUT << "version " << NOSO_2M_VERSION << std::endl;
         std::exit( EXIT_SUCCESS );
     }
+    if ( parsed_options.count( "bench" ) ) {
+        CNosoHashKernel kernel { CNosoHashKernel::AUTO };
+        std::string const hasher { parsed_options["hasher"].as<std::string>() };
+        if ( !nosohash_kernel_from_name( hasher, kernel ) || !nosohash_kernel_supported( kernel ) ) {
+            NOSO_STDERR << "Invalid or unsupported hasher '" << hasher << "'" << std::endl;
+            std::exit( EXIT_FAILURE );
+        }
+        CNosoAffinity affinity { CNosoAffinity::NONE };
+        std::vector<std::uint32_t> affinity_cpus;
+        std::string const affinity_name { parsed_options["affinity"].as<std::string>() };
+        if ( !noso_affinity_from_name( affinity_name, affinity, affinity_cpus ) ) {
+            NOSO_STDERR << "Invalid affinity '" << affinity_name << "'" << std::endl;
+            std::exit( EXIT_FAILURE );
+        }
+        int rc { CBenchmark::Run( kernel, affinity, affinity_cpus, parsed_options["bench"].as<std::string>() ) };
+        std::exit( rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE );
+    }
     NOSO_LOG_INIT();
     NOSO_LOG_INFO << "noso-2m - A miner for Nosocryptocurrency Protocol-2" << std::endl;
     NOSO_LOG_INFO << "f04ever (c) 2022 https://github.com/f04ever/noso-2m" << std::endl;
@@ -95,7 +129,7 @@ int main( int argc, char *argv[] ) {
     }
     char msgbuf[100];
     std::snprintf( msgbuf, 100, "%-31s        | %d threads",
-            g_miner_address, g_pool_threads_count );
+            g_miner_address, g_mining_threads_count );
     NOSO_TUI_OutputHeadPad( msgbuf );
     NOSO_TUI_OutputHeadWin();
     std::string msgstr { "" };
@@ -106,8 +140,18 @@ int main( int argc, char *argv[] ) {
     NOSO_LOG_INFO << msgstr << std::endl;
     NOSO_TUI_OutputHistPad( msgstr.c_str() );
     msgstr = std::string( "- Hashing threads: " )
-            + std::to_string( g_pool_threads_count )
-            + " threads per pool";
+            + std::to_string( g_mining_threads_count )
+            + " threads shared by all pools";
+    NOSO_LOG_INFO << msgstr << std::endl;
+    NOSO_TUI_OutputHistPad( msgstr.c_str() );
+    msgstr = std::string( "-  Hashing kernel: " )
+            + nosohash_kernel_name( g_hash_kernel );
+    NOSO_LOG_INFO << msgstr << std::endl;
+    NOSO_TUI_OutputHistPad( msgstr.c_str() );
+    msgstr = std::string( "- Thread affinity: " )
+            + noso_affinity_name( g_threads_affinity );
+    for ( std::size_t i = 0; i < g_affinity_cpus.size() && i < g_mining_threads_count; ++i )
+        msgstr += ( i == 0 ? " CPU " : "," ) + std::to_string( g_affinity_cpus[i] );
     NOSO_LOG_INFO << msgstr << std::endl;
     NOSO_TUI_OutputHistPad( msgstr.c_str() );
     msgstr = std::string( "-    Shares limit: " )
@@ -115,6 +159,11 @@ int main( int argc, char *argv[] ) {
             + " shares per pool";
     NOSO_LOG_INFO << msgstr << std::endl;
     NOSO_TUI_OutputHistPad( msgstr.c_str() );
+    msgstr = std::string( "-       In flight: " )
+            + std::to_string( g_pool_inflight_shares )
+            + " shares per pool";
+    NOSO_LOG_INFO << msgstr << std::endl;
+    NOSO_TUI_OutputHistPad( msgstr.c_str() );
     if ( g_binding_address[0] ) {
         msgstr = std::string( "-    Binding IPv4: " )
                 + g_binding_address;
@@ -128,7 +177,9 @@ int main( int argc, char *argv[] ) {
                         ? "-    Mining pools: "
                         : "                 : " )
                 + lpad( std::get<0>( *itor ), 12, ' ' ).substr( 0, 12 )
-                + "(" + std::get<1>( *itor ) + ":" + std::get<2>( *itor ) + ")";
+                + "(" + std::get<1>( *itor ) + ":" + std::get<2>( *itor ) + ")"
+                + ( std::get<3>( *itor ) != DEFAULT_POOL_WEIGHT
+                        ? " weight " + std::to_string( std::get<3>( *itor ) ) : "" );
         NOSO_LOG_INFO << msgstr << std::endl;
         NOSO_TUI_OutputHistPad( msgstr.c_str() );
     }
@@ -211,12 +262,21 @@ int main( int argc, char *argv[] ) {
             NOSO_TUI_OutputStatPad( msgstr.c_str() );
             NOSO_TUI_OutputStatWin(); } );
 #endif // OF #ifdef NO_TEXTUI ... #else
+        CMineScheduler mine_scheduler { g_mining_threads_count, g_hash_kernel, g_mining_pools, g_affinity_cpus };
+        // one comm thread per pool, their exchanges all run on the reactor
+        // thread. The comm objects outlive the mining threads, which may
+        // still push the hits of a slice to the pool of a comm thread
+        // already returned
+        std::vector<std::shared_ptr<CCommThread>> comm_objects;
         std::vector<std::thread> comm_threads;
-        for ( auto pool : g_mining_pools ) {
-            auto comm_object { std::make_shared<CCommThread>( g_pool_threads_count, pool, bind_serv ) };
-            comm_threads.emplace_back( &CCommThread::Communicate, comm_object );
+        for ( std::size_t pool_index = 0; pool_index < g_mining_pools.size(); ++pool_index ) {
+            comm_objects.push_back( std::make_shared<CCommThread>( pool_index, g_mining_pools[pool_index],
+                    mine_scheduler, bind_serv ) );
+            comm_threads.emplace_back( &CCommThread::Communicate, comm_objects.back() );
         }
         for ( auto &comm_thread : comm_threads ) comm_thread.join();
+        g_still_running = false;
+        mine_scheduler.Stop();
         if ( bind_serv ) {
             freeaddrinfo( bind_serv );
         }
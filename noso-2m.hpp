@@ -6,13 +6,22 @@
 #endif
 
 #include <tuple>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
 
 #include "config.hpp"
 
+#if defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 )
+#define NOSO_HASHING_X86
+#endif
+
 #define NOSO_NUL_HASH "00000000000000000000000000000000"
 #define NOSO_MAX_DIFF "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"
-#define NOSO_TIMESTAMP ( (long long)( std::time( 0 ) ) )
+// of the network clock, as the mining period times below
+#define NOSO_TIMESTAMP ( (long long)( std::chrono::duration_cast<std::chrono::seconds>( \
+            noso_network_time() ).count() ) )
 #define NOSO_BLOCK_AGE ( NOSO_TIMESTAMP % 600 )
 #define NOSO_BLOCK_AGE_INNER_MINING_PERIOD                      \
             (   ( 10 <= NOSO_BLOCK_AGE )                        \
@@ -25,7 +34,54 @@
             (   ( NOSO_BLOCK_AGE_BEFORE_MINING_PERIOD )         \
                    || ( NOSO_BLOCK_AGE_BEHIND_MINING_PERIOD )   )
 
-typedef std::tuple<std::string, std::string, std::string> pool_specs_t;
+// The offset of the network time, the clock of the pools, to the steady clock
+// in nanoseconds. It starts from the system clock, then the comm threads
+// estimate it from the SOURCE exchanges with the pools
+extern std::atomic<std::int64_t> g_network_clock_offset;
+
+inline
+std::int64_t noso_system_clock_offset() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch() ).count()
+        - std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// The network time since the epoch at the steady clock time given. Being
+// driven by the steady clock it neither jumps nor lags behind as the system
+// clock may, the coarse one std::time reads a tick behind
+inline
+std::chrono::nanoseconds noso_network_time(
+        std::chrono::steady_clock::time_point steady_time = std::chrono::steady_clock::now() ) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( steady_time.time_since_epoch() )
+        + std::chrono::nanoseconds( g_network_clock_offset.load( std::memory_order_relaxed ) );
+}
+
+// The steady clock time at which the running block leaves the mining period,
+// when its age turns 586 and NOSO_BLOCK_AGE_INNER_MINING_PERIOD false. Already
+// passed when the age is over 585
+inline
+std::chrono::steady_clock::time_point noso_mining_period_deadline() {
+    auto const steady_now { std::chrono::steady_clock::now() };
+    auto const block_age { noso_network_time( steady_now ) % std::chrono::seconds( 600 ) };
+    return steady_now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::seconds( 586 ) - block_age );
+}
+
+// The steady clock time at which the next mining period opens, when the age
+// of the block turns 10 and NOSO_BLOCK_AGE_INNER_MINING_PERIOD true. Already
+// passed when the age is within the mining period
+inline
+std::chrono::steady_clock::time_point noso_mining_period_opening() {
+    auto const steady_now { std::chrono::steady_clock::now() };
+    auto const block_age { noso_network_time( steady_now ) % std::chrono::seconds( 600 ) };
+    return steady_now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            ( block_age >= std::chrono::seconds( 586 ) ? std::chrono::seconds( 610 ) : std::chrono::seconds( 10 ) )
+                - block_age );
+}
+
+// name, host, port and weight of a mining pool
+typedef std::tuple<std::string, std::string, std::string, std::uint32_t> pool_specs_t;
 
 #endif // __NOSO2M_HPP__
 
@@ -0,0 +1,123 @@
+#ifndef __NOSO2M_PROFILE_HPP__
+#define __NOSO2M_PROFILE_HPP__
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+// Per-stage cycle profiling of the hashing pipeline, built only with
+// -DNOSO_PROFILE. Otherwise NOSO_PROFILE_STAGE and NOSO_PROFILE_THREAD expand
+// to nothing and no profiling code or data is compiled in.
+#ifdef NOSO_PROFILE
+
+#include <bit>
+#include <ctime>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "noso-2m.hpp"
+
+#ifdef NOSO_HASHING_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif // NOSO_HASHING_X86
+
+enum class CNosoStage : std::size_t { ITOA, STAT, PACK, MD5D, CHECK, };
+
+constexpr static
+std::size_t const NOSO_PROFILE_STAGES { 5 };
+
+constexpr static
+char const * const noso_profile_stage_names[NOSO_PROFILE_STAGES] {
+        "_itoa", "_stat", "_pack", "_md5d", "match", };
+
+// Cycles per hash of one stage. Bucket i of the histogram counts the calls
+// that took [2^(i-1), 2^i) cycles per hash, bucket 0 the ones under a cycle
+struct CNosoStageProfile {
+    std::uint64_t calls { 0 };
+    std::uint64_t hashes { 0 };
+    std::uint64_t cycles { 0 };
+    std::uint64_t buckets[64] {};
+    void Add( std::uint64_t elapsed, std::uint64_t count ) {
+        ++calls;
+        hashes += count;
+        cycles += elapsed;
+        ++buckets[std::min<std::size_t>( std::bit_width( elapsed / count ), 63 )];
+    }
+    void Merge( CNosoStageProfile const & other ) {
+        calls += other.calls;
+        hashes += other.hashes;
+        cycles += other.cycles;
+        for ( std::size_t i = 0; i < 64; ++i ) buckets[i] += other.buckets[i];
+    }
+    double Mean() const {
+        return hashes > 0 ? double( cycles ) / hashes : 0.;
+    }
+    // upper bound of the bucket holding the given fraction of the calls
+    std::uint64_t Percentile( double fraction ) const {
+        std::uint64_t const rank { static_cast<std::uint64_t>( fraction * calls ) };
+        std::uint64_t seen { 0 };
+        for ( std::size_t i = 0; i < 64; ++i ) {
+            seen += buckets[i];
+            if ( seen > rank ) return std::uint64_t( 1 ) << i;
+        }
+        return 0;
+    }
+};
+
+struct CNosoThreadProfile {
+    CNosoStageProfile stages[NOSO_PROFILE_STAGES];
+    void Merge( CNosoThreadProfile const & other ) {
+        for ( std::size_t i = 0; i < NOSO_PROFILE_STAGES; ++i ) stages[i].Merge( other.stages[i] );
+    }
+    void Reset() {
+        for ( auto & stage : stages ) stage = CNosoStageProfile {};
+    }
+};
+
+inline
+std::uint64_t noso_profile_ticks() {
+#ifdef NOSO_HASHING_X86
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return std::uint64_t( ts.tv_sec ) * 1'000'000'000 + ts.tv_nsec;
+#endif // NOSO_HASHING_X86
+}
+
+// The profile of the running thread, set by the mining threads. Stages timed
+// on other threads (e.g. the benchmark) are not recorded
+inline thread_local CNosoThreadProfile * t_noso_profile { nullptr };
+
+class CNosoStageTimer {
+    CNosoStage const m_stage;
+    std::uint64_t const m_hashes;
+    std::uint64_t const m_begin;
+public:
+    CNosoStageTimer( CNosoStage stage, std::uint64_t hashes )
+        :   m_stage { stage }, m_hashes { hashes }, m_begin { noso_profile_ticks() } {
+    }
+    ~CNosoStageTimer() {
+        if ( t_noso_profile )
+            t_noso_profile->stages[static_cast<std::size_t>( m_stage )].Add(
+                    noso_profile_ticks() - m_begin, m_hashes );
+    }
+};
+
+#define NOSO_PROFILE_STAGE( stage, hashes ) \
+            CNosoStageTimer const _noso_stage_timer { ( stage ), ( hashes ) }
+#define NOSO_PROFILE_THREAD( profile ) ( t_noso_profile = ( profile ) )
+
+#else // OF #ifdef NOSO_PROFILE
+
+#define NOSO_PROFILE_STAGE( stage, hashes ) ((void)0)
+#define NOSO_PROFILE_THREAD( profile ) ((void)0)
+
+#endif // OF #ifdef NOSO_PROFILE ... #else
+
+#endif // __NOSO2M_PROFILE_HPP__
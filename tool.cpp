@@ -23,7 +23,7 @@ int CTools::ShowPoolInformation( std::vector<pool_specs_t> const & mining_pools
     std::snprintf( msg, 200, "-----------------------------------------------------------------------------------" );
     NOSO_TUI_OutputInfoPad( msg );
     std::for_each( std::cbegin( mining_pools ), std::cend( mining_pools ),
-            [&, idx = 0]( std::tuple<std::string, std::string, std::string> const & pool ) mutable {
+            [&, idx = 0]( pool_specs_t const & pool ) mutable {
                 CPoolInet inet { std::get<0>( pool ), std::get<1>( pool ), std::get<2>( pool ),
                         DEFAULT_POOL_INET_TIMEOSEC };
                 int rsize { inet.RequestPoolInfo(
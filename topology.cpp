@@ -0,0 +1,235 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <tuple>
+#include <thread>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined( __linux__ ) // LINUX/ANDROID
+#include <sched.h>
+#endif // _WIN32
+
+#include "topology.hpp"
+
+// "0-3,8,10-11" as the CPU lists of /sys and taskset -c are written
+bool noso_cpu_list_parse( std::string const & str, std::vector<std::uint32_t> & cpus ) {
+    cpus.clear();
+    std::size_t pos { 0 };
+    while ( pos < str.length() ) {
+        std::size_t const end { std::min( str.find( ',', pos ), str.length() ) };
+        std::string const range { str.substr( pos, end - pos ) };
+        std::size_t const dash { range.find( '-' ) };
+        try {
+            std::size_t first_len { 0 }, last_len { 0 };
+            std::uint32_t const first = std::stoul( range.substr( 0, dash ), &first_len );
+            std::uint32_t const last = dash == std::string::npos ? first
+                : std::stoul( range.substr( dash + 1 ), &last_len );
+            if ( first_len != std::min( dash, range.length() )
+                    || ( dash != std::string::npos && last_len != range.length() - dash - 1 )
+                    || last < first || last >= 4096 )
+                return false;
+            for ( std::uint32_t cpu = first; cpu <= last; ++cpu ) cpus.push_back( cpu );
+        } catch ( std::logic_error const & e ) {
+            return false;
+        }
+        pos = end + 1;
+    }
+    return cpus.size() > 0;
+}
+
+#ifdef __linux__
+inline
+bool topology_read( std::string const & path, std::string & value ) {
+    std::ifstream ifs( path );
+    return ifs.good() && std::getline( ifs, value ) && value.length() > 0;
+}
+
+inline
+std::uint32_t topology_read_id( std::string const & path, std::uint32_t fallback ) {
+    std::string value;
+    if ( !topology_read( path, value ) ) return fallback;
+    try {
+        return std::stoul( value );
+    } catch ( std::logic_error const & e ) {
+        return fallback;
+    }
+}
+
+// The directories of the cgroup of the process for a cgroup v1 controller,
+// or for cgroup v2 when controller is empty, from its own up to the root of
+// the hierarchy. Inside a container without its own cgroup namespace the
+// path is the one of the host, then only the root of the mount is there
+inline
+std::vector<std::string> cgroup_dirs( std::string const & controller ) {
+    std::vector<std::string> dirs;
+    std::ifstream ifs( "/proc/self/cgroup" );
+    std::string line;
+    while ( std::getline( ifs, line ) ) {
+        std::size_t const colon1 { line.find( ':' ) };
+        std::size_t const colon2 { line.find( ':', colon1 + 1 ) };
+        if ( colon1 == std::string::npos || colon2 == std::string::npos ) continue;
+        std::string const controllers { line.substr( colon1 + 1, colon2 - colon1 - 1 ) };
+        if ( controller.empty() ? !controllers.empty()
+                : ( "," + controllers + "," ).find( "," + controller + "," ) == std::string::npos )
+            continue;
+        std::vector<std::string> const mounts { controller.empty()
+                ? std::vector<std::string> { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" }
+                : std::vector<std::string> { "/sys/fs/cgroup/" + controllers, "/sys/fs/cgroup/" + controller } };
+        for ( auto const & mount : mounts ) {
+            for ( std::string path { line.substr( colon2 + 1 ) }; ; path.erase( path.rfind( '/' ) ) ) {
+                dirs.push_back( mount + ( path == "/" ? "" : path ) );
+                if ( path.rfind( '/' ) == std::string::npos || path == "/" ) break;
+            }
+        }
+    }
+    return dirs;
+}
+
+// The CPU time the cgroups of the process may take per period, in CPUs, the
+// lowest limit along the hierarchy. 0 when unlimited
+inline
+double cgroup_cpu_quota() {
+    double quota { 0. };
+    auto const limit = [&]( std::string const & max, std::string const & period ) {
+        try {
+            double const cpus { std::stod( max ) }, period_cpus { std::stod( period ) };
+            if ( cpus > 0. && period_cpus > 0. && ( quota <= 0. || cpus / period_cpus < quota ) )
+                quota = cpus / period_cpus;
+        } catch ( std::logic_error const & e ) {
+            // "max", unlimited
+        }
+    };
+    std::string max, period;
+    for ( auto const & dir : cgroup_dirs( "" ) ) {
+        // "max 100000" or "200000 100000"
+        if ( !topology_read( dir + "/cpu.max", max ) ) continue;
+        std::size_t const space { max.find( ' ' ) };
+        if ( space != std::string::npos ) limit( max.substr( 0, space ), max.substr( space + 1 ) );
+    }
+    for ( auto const & dir : cgroup_dirs( "cpu" ) ) {
+        // cpu.cfs_quota_us is -1 when unlimited
+        if ( topology_read( dir + "/cpu.cfs_quota_us", max )
+                && topology_read( dir + "/cpu.cfs_period_us", period ) )
+            limit( max, period );
+    }
+    return quota;
+}
+
+// The CPUs of the cpuset of the process, effective ones first, 0 when none
+// can be read
+inline
+std::uint32_t cgroup_cpuset_count() {
+    std::string value;
+    std::vector<std::uint32_t> cpus;
+    for ( auto const & dir : cgroup_dirs( "" ) )
+        if ( topology_read( dir + "/cpuset.cpus.effective", value ) && noso_cpu_list_parse( value, cpus ) )
+            return cpus.size();
+    for ( auto const & dir : cgroup_dirs( "cpuset" ) )
+        if ( ( topology_read( dir + "/cpuset.effective_cpus", value ) || topology_read( dir + "/cpuset.cpus", value ) )
+                && noso_cpu_list_parse( value, cpus ) )
+            return cpus.size();
+    return 0;
+}
+#endif // __linux__
+
+// The CPUs the hashing threads can keep busy: the ones the process may run
+// on within its cpuset, and no more than the CPU quota of its cgroups,
+// rounded down to leave the fraction to the comm threads, at least one
+std::uint32_t noso_usable_cpus() {
+    std::uint32_t cpus = noso_cpu_topology().size();
+#ifdef __linux__
+    std::uint32_t const cpuset { cgroup_cpuset_count() };
+    if ( cpuset > 0 ) cpus = std::min( cpus, cpuset );
+    double const quota { cgroup_cpu_quota() };
+    if ( quota > 0. ) cpus = std::min( cpus, std::max( 1u, static_cast<std::uint32_t>( quota ) ) );
+#endif // __linux__
+    return std::max( 1u, cpus );
+}
+
+std::vector<CNosoCpu> noso_cpu_topology() {
+    std::vector<CNosoCpu> topology;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO( &allowed );
+    if ( sched_getaffinity( 0, sizeof( allowed ), &allowed ) != 0 ) return topology;
+    std::string value;
+    std::vector<std::uint32_t> siblings;
+    for ( std::uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+        if ( !CPU_ISSET( cpu, &allowed ) ) continue;
+        std::string const path { "/sys/devices/system/cpu/cpu" + std::to_string( cpu ) + "/topology/" };
+        CNosoCpu info { cpu, cpu, 0, 0, 0 };
+        info.core = topology_read_id( path + "core_id", cpu );
+        info.package = topology_read_id( path + "physical_package_id", 0 );
+        if ( topology_read( path + "thread_siblings_list", value ) && noso_cpu_list_parse( value, siblings ) )
+            info.smt_rank = std::find( siblings.begin(), siblings.end(), cpu ) - siblings.begin();
+        topology.push_back( info );
+    }
+    // the CPUs of each NUMA node, nodes are numbered without gaps
+    for ( std::uint32_t node = 0; topology_read( "/sys/devices/system/node/node"
+            + std::to_string( node ) + "/cpulist", value ); ++node ) {
+        if ( !noso_cpu_list_parse( value, siblings ) ) continue;
+        for ( auto & info : topology )
+            if ( std::find( siblings.begin(), siblings.end(), info.cpu ) != siblings.end() ) info.node = node;
+    }
+#endif // __linux__
+    if ( topology.empty() ) {
+        std::uint32_t const count { std::max( 1u, std::thread::hardware_concurrency() ) };
+        for ( std::uint32_t cpu = 0; cpu < count; ++cpu ) topology.push_back( { cpu, cpu, 0, 0, 0 } );
+    }
+    return topology;
+}
+
+bool noso_affinity_from_name( std::string const & name, CNosoAffinity & affinity, std::vector<std::uint32_t> & cpus ) {
+    cpus.clear();
+    if ( name == "none" ) affinity = CNosoAffinity::NONE;
+    else if ( name == "auto" ) affinity = CNosoAffinity::AUTO;
+    else if ( noso_cpu_list_parse( name, cpus ) ) affinity = CNosoAffinity::LIST;
+    else return false;
+    return true;
+}
+
+char const * noso_affinity_name( CNosoAffinity affinity ) {
+    switch ( affinity ) {
+    case CNosoAffinity::AUTO: return "auto";
+    case CNosoAffinity::LIST: return "list";
+    default: return "none";
+    }
+}
+
+// The CPUs to pin the hashing threads to, thread i to the CPU i modulo their
+// count, none when not pinning. auto takes the first SMT thread of every
+// physical core, node by node, before any SMT sibling
+std::vector<std::uint32_t> noso_affinity_cpus( CNosoAffinity affinity, std::vector<std::uint32_t> const & cpus ) {
+    if ( affinity == CNosoAffinity::LIST ) return cpus;
+    std::vector<std::uint32_t> affinity_cpus;
+    if ( affinity != CNosoAffinity::AUTO ) return affinity_cpus;
+    std::vector<CNosoCpu> topology { noso_cpu_topology() };
+    std::stable_sort( topology.begin(), topology.end(), []( auto const & a, auto const & b ) {
+            return std::tie( a.smt_rank, a.node, a.package, a.core, a.cpu )
+                    < std::tie( b.smt_rank, b.node, b.package, b.core, b.cpu ); } );
+    for ( auto const & info : topology ) affinity_cpus.push_back( info.cpu );
+    return affinity_cpus;
+}
+
+// Pins the calling thread. Memory it touches first afterwards is allocated
+// on the NUMA node of the CPU under the default Linux policy
+bool noso_pin_thread( std::uint32_t cpu ) {
+#ifdef _WIN32
+    if ( cpu >= 8 * sizeof( DWORD_PTR ) ) return false;
+    return SetThreadAffinityMask( GetCurrentThread(), DWORD_PTR( 1 ) << cpu ) != 0;
+#elif defined( __linux__ )
+    if ( cpu >= CPU_SETSIZE ) return false;
+    cpu_set_t cpu_set;
+    CPU_ZERO( &cpu_set );
+    CPU_SET( cpu, &cpu_set );
+    return sched_setaffinity( 0, sizeof( cpu_set ), &cpu_set ) == 0;
+#else // macOS has no thread to CPU pinning
+    (void)cpu;
+    return false;
+#endif // _WIN32
+}
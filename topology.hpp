@@ -0,0 +1,36 @@
+#ifndef __NOSO2M_TOPOLOGY_HPP__
+#define __NOSO2M_TOPOLOGY_HPP__
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "noso-2m.hpp"
+
+// A logical CPU the process may run on, as /sys/devices/system/cpu describes
+// it. smt_rank is the position of the CPU among the SMT siblings of its core,
+// 0 for the first one. Where the topology can not be read every CPU is a
+// core of its own on package and node 0
+struct CNosoCpu {
+    std::uint32_t cpu;
+    std::uint32_t core;
+    std::uint32_t package;
+    std::uint32_t node;
+    std::uint32_t smt_rank;
+};
+
+enum class CNosoAffinity { NONE, AUTO, LIST, };
+
+std::vector<CNosoCpu> noso_cpu_topology();
+std::uint32_t noso_usable_cpus();
+bool noso_cpu_list_parse( std::string const & str, std::vector<std::uint32_t> & cpus );
+bool noso_affinity_from_name( std::string const & name, CNosoAffinity & affinity, std::vector<std::uint32_t> & cpus );
+char const * noso_affinity_name( CNosoAffinity affinity );
+std::vector<std::uint32_t> noso_affinity_cpus( CNosoAffinity affinity, std::vector<std::uint32_t> const & cpus );
+bool noso_pin_thread( std::uint32_t cpu );
+
+#endif // __NOSO2M_TOPOLOGY_HPP__